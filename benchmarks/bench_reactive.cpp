@@ -0,0 +1,310 @@
+#include <QtTest/QtTest>
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QStringListModel>
+
+#include <cstdlib>
+#include <new>
+
+#include "qreactiveproxymodel.h"
+#include "qmultimodeltree.h"
+
+// Count the heap allocations. The Qt containers and QVariant use malloc
+// directly, so on glibc it is interposed (operator new uses it too).
+// Elsewhere only operator new is counted and the report says so.
+static QAtomicInt s_Allocations;
+
+#if defined(__GLIBC__)
+static const char allocation_unit[] = "mallocs";
+
+extern "C" {
+    void* __libc_malloc (std::size_t size);
+    void* __libc_calloc (std::size_t count, std::size_t size);
+    void* __libc_realloc(void* p, std::size_t size);
+
+    void* malloc(std::size_t size) __THROW
+    {
+        s_Allocations.ref();
+        return __libc_malloc(size);
+    }
+
+    void* calloc(std::size_t count, std::size_t size) __THROW
+    {
+        s_Allocations.ref();
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, std::size_t size) __THROW
+    {
+        s_Allocations.ref();
+        return __libc_realloc(p, size);
+    }
+}
+#else
+static const char allocation_unit[] = "operator new (malloc excluded)";
+
+void* operator new(std::size_t size)
+{
+    s_Allocations.ref();
+
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+#endif
+
+/**
+ * A flat list of integers. Each index gets a unique internal id.
+ */
+class SyntheticModel final : public QAbstractTableModel
+{
+public:
+    explicit SyntheticModel(int rows) : m_lValues(rows, 0) {}
+
+    virtual int rowCount(const QModelIndex& parent = {}) const override {
+        return parent.isValid() ? 0 : m_lValues.size();
+    }
+
+    virtual int columnCount(const QModelIndex& parent = {}) const override {
+        return parent.isValid() ? 0 : 1;
+    }
+
+    virtual QModelIndex index(int row, int column, const QModelIndex& parent = {}) const override {
+        if (parent.isValid() || column || row < 0 || row >= m_lValues.size())
+            return {};
+
+        return createIndex(row, column, quintptr(row + 1));
+    }
+
+    virtual QVariant data(const QModelIndex& idx, int role) const override {
+        if (role != Qt::DisplayRole && role != Qt::EditRole)
+            return {};
+
+        return m_lValues[idx.row()];
+    }
+
+    virtual bool setData(const QModelIndex& idx, const QVariant& value, int role) override {
+        if (role != Qt::EditRole)
+            return false;
+
+        m_Writes++;
+
+        const int v = value.toInt();
+
+        // Stop the propagation when nothing changes
+        if (m_lValues[idx.row()] == v)
+            return true;
+
+        m_lValues[idx.row()] = v;
+
+        Q_EMIT dataChanged(idx, idx, {Qt::EditRole});
+
+        return true;
+    }
+
+    virtual Qt::ItemFlags flags(const QModelIndex& idx) const override {
+        Q_UNUSED(idx)
+        return Qt::ItemIsEnabled | Qt::ItemIsEditable
+            | Qt::ItemIsDragEnabled | Qt::ItemIsDropEnabled;
+    }
+
+    /// Change all values and notify them with a single range
+    void touchAll() {
+        for (int& v : m_lValues)
+            v++;
+
+        Q_EMIT dataChanged(index(0, 0), index(m_lValues.size() - 1, 0), {Qt::EditRole});
+    }
+
+    QVector<int> m_lValues;
+    int          m_Writes {0};
+};
+
+struct Fixture
+{
+    explicit Fixture(int rows) : m_Source(rows) {
+        m_Proxy.setSourceModel(&m_Source);
+        m_Proxy.addConnectedRole(Qt::EditRole);
+    }
+
+    bool connect(int from, int to) {
+        return m_Proxy.connectIndices(m_Proxy.index(from, 0), m_Proxy.index(to, 0));
+    }
+
+    // Change a value, the writes it causes are counted by the source
+    void trigger(int row) {
+        const auto idx = m_Proxy.index(row, 0);
+        m_Proxy.setData(idx, idx.data(Qt::EditRole).toInt() + 1, Qt::EditRole);
+        m_Triggers++;
+    }
+
+    SyntheticModel      m_Source;
+    QReactiveProxyModel m_Proxy;
+    qint64              m_Triggers {0};
+};
+
+/**
+ * Measure the propagation throughput of QReactiveProxyModel. Each benchmark
+ * reports the number of propagated writes per second and the heap
+ * allocations per propagated write, so the engine changes can be compared.
+ *
+ * The results are checked after measuring, a topology the engine doesn't
+ * propagate correctly fails rather than reporting meaningless numbers. The
+ * engine keeps every connection of an index, so each sink of the fan-out
+ * and both branches of the diamonds are reached.
+ */
+class BenchReactive final : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void chain();
+    void fanOut();
+    void diamonds();
+    void rangeUnconnected();
+    void removeAbove();
+
+private:
+    // Wrap the QBENCHMARK to collect the counters
+    template<typename F>
+    void measure(const char* name, Fixture& f, const F& body);
+};
+
+template<typename F>
+void BenchReactive::measure(const char* name, Fixture& f, const F& body)
+{
+    f.m_Source.m_Writes = 0;
+    f.m_Triggers        = 0;
+
+    const int allocations = s_Allocations.load();
+
+    QElapsedTimer t;
+    t.start();
+
+    QBENCHMARK {
+        body();
+    }
+
+    const qint64 nsecs = t.nsecsElapsed();
+
+    // The triggers are writes too
+    const qint64 propagations = f.m_Source.m_Writes - f.m_Triggers;
+    const int    allocs       = s_Allocations.load() - allocations;
+
+    qDebug("%s: %lld propagations, %.0f propagations/s, %.2f %s/propagation",
+        name,
+        propagations,
+        nsecs ? propagations * 1e9 / nsecs : 0.0,
+        propagations ? qreal(allocs) / propagations : 0.0,
+        allocation_unit
+    );
+}
+
+/// 1k hops, each write propagates to the next row
+void BenchReactive::chain()
+{
+    static const int hops = 1000;
+
+    Fixture f(hops + 1);
+
+    for (int i = 0; i < hops; i++)
+        QVERIFY(f.connect(i, i + 1));
+
+    measure("chain", f, [&f]() { f.trigger(0); });
+
+    QCOMPARE(f.m_Source.m_lValues.last(), f.m_Source.m_lValues.first());
+}
+
+/// A single source connected to 10k sinks
+void BenchReactive::fanOut()
+{
+    static const int sinks = 10000;
+
+    Fixture f(sinks + 1);
+
+    for (int i = 1; i <= sinks; i++)
+        QVERIFY(f.connect(0, i));
+
+    measure("fan-out", f, [&f]() { f.trigger(0); });
+
+    for (int i = 1; i <= sinks; i++)
+        QCOMPARE(f.m_Source.m_lValues[i], f.m_Source.m_lValues.first());
+}
+
+/// 1k independent a -> (b, c) -> d diamonds, one triggered per iteration
+void BenchReactive::diamonds()
+{
+    static const int count = 1000;
+
+    Fixture f(count * 4);
+
+    for (int i = 0; i < count; i++) {
+        const int a = i * 4;
+        QVERIFY(f.connect(a    , a + 1));
+        QVERIFY(f.connect(a    , a + 2));
+        QVERIFY(f.connect(a + 1, a + 3));
+        QVERIFY(f.connect(a + 2, a + 3));
+    }
+
+    int next = 0;
+
+    measure("diamonds", f, [&f, &next]() {
+        f.trigger((next++ % count) * 4);
+    });
+
+    // Every node of a diamond holds the value of its source
+    for (int i = 0; i < count * 4; i++)
+        QCOMPARE(f.m_Source.m_lValues[i], f.m_Source.m_lValues[i - i % 4]);
+}
+
+/// A 100k rows dataChanged where only 1% of the rows are connected
+void BenchReactive::rangeUnconnected()
+{
+    static const int rows = 100000;
+
+    Fixture f(rows);
+
+    for (int i = 0; i + 1 < rows; i += 100)
+        QVERIFY(f.connect(i, i + 1));
+
+    measure("range", f, [&f]() { f.m_Source.touchAll(); });
+}
+
+/// Not a benchmark, the connections must follow the rows removed above them
+void BenchReactive::removeAbove()
+{
+    QStringListModel source({"a", "b", "c", "d"});
+
+    QMultiModelTree tree;
+    const auto root = tree.appendModel(&source);
+
+    QReactiveProxyModel proxy;
+    proxy.setSourceModel(&tree);
+    proxy.addConnectedRole(Qt::EditRole);
+
+    const auto top = proxy.index(root.row(), 0);
+
+    QVERIFY(proxy.connectIndices(proxy.index(2, 0, top), proxy.index(3, 0, top)));
+    QCOMPARE(source.stringList(), QStringList({"a", "b", "c", "c"}));
+
+    QVERIFY(source.removeRow(0));
+
+    // "c" is now the row 1 and still propagates
+    QVERIFY(proxy.setData(proxy.index(1, 0, top), QStringLiteral("e"), Qt::EditRole));
+    QCOMPARE(source.stringList(), QStringList({"b", "e", "e"}));
+
+    // The row 2 is now the destination, nothing flows from it
+    QVERIFY(proxy.setData(proxy.index(2, 0, top), QStringLiteral("f"), Qt::EditRole));
+    QCOMPARE(source.stringList(), QStringList({"b", "e", "f"}));
+}
+
+QTEST_GUILESS_MAIN(BenchReactive)
+
+#include "bench_reactive.moc"
@@ -58,6 +58,8 @@ GraphicsDirectedEdge(QNodeEditorEdgeModel* m, const QModelIndex& index, qreal fa
     d_ptr->_pen.setWidth(2);
     d_ptr->m_pGrpahicsItem->setZValue(-1);
 
+    updateStyle();
+
 #if 0
     d_ptr->_effect->setBlurRadius(15.0);
     d_ptr->_effect->setColor(QColor("#99050505"));
@@ -70,6 +72,21 @@ void GraphicsDirectedEdge::update()
     d_ptr->m_pGrpahicsItem->updatePath();
 }
 
+void GraphicsDirectedEdge::updateStyle()
+{
+    const auto fg = d_ptr->m_Index.data(Qt::ForegroundRole);
+
+    // Set the line color
+    if (fg.canConvert<QBrush>())
+        d_ptr->m_Pen = QPen(qvariant_cast<QBrush>(fg), d_ptr->_pen.width());
+    else if (fg.canConvert<QPen>())
+        d_ptr->m_Pen = qvariant_cast<QPen>(fg);
+    else
+        d_ptr->m_Pen = d_ptr->_pen;
+
+    d_ptr->m_pGrpahicsItem->update();
+}
+
 int GraphicsBezierItem::
 type() const
 {
@@ -140,6 +157,20 @@ updatePath()
 
     QPointF c2 = sinkI.canConvert<QPointF>() ? sinkI.toPointF() : d_ptr->_stop;
 
+    // Use the orthogonal route as long as it matches the anchors, the bezier
+    // is shown while a new one is being computed
+    const auto& route = d_ptr->m_lRoute;
+
+    if (route.size() >= 2 && route.first() == c1 && route.last() == c2) {
+        QPainterPath path(c1);
+
+        for (int i = 1; i < route.size(); i++)
+            path.lineTo(route[i]);
+
+        setPath(path);
+        return;
+    }
+
     const qreal dist = (c1.x() <= c2.x()) ?
         std::max(min_dist, (c2.x() - c1.x()) * d_ptr->_factor):
         std::max(min_dist, (c1.x() - c2.x()) * d_ptr->_factor);
@@ -170,17 +201,7 @@ paint(QPainter * painter, const QStyleOptionGraphicsItem * opt, QWidget *w)
     Q_UNUSED(opt)
     Q_UNUSED(w)
 
-    const auto fg = d_ptr->m_Index.data(Qt::ForegroundRole);
-
-    // Set the line color
-    if (fg.canConvert<QBrush>())
-        painter->setPen(QPen(qvariant_cast<QBrush>(fg),d_ptr->_pen.width()));
-    else if (fg.canConvert<QPen>())
-        painter->setPen(qvariant_cast<QPen>(fg));
-    else
-        painter->setPen(d_ptr->_pen);
-
-
+    painter->setPen(d_ptr->m_Pen);
     painter->drawPath(path());
 }
 
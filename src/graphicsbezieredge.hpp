@@ -19,6 +19,7 @@ class GraphicsDirectedEdge : public QObject
     friend class GraphicsNodeSocketPrivate; //To allow intermediate positions
 
     friend class QNodeEditorSocketModelPrivate; // to notify changes
+    friend class QNodeEditorSocketModel; // to take snapshots
 
     Q_OBJECT
 public:
@@ -26,6 +27,7 @@ public:
     virtual ~GraphicsDirectedEdge();
 
     void update();
+    void updateStyle();
 
     QGraphicsItem *graphicsItem() const;
 
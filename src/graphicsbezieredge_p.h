@@ -3,6 +3,7 @@
 
 #include <QGraphicsDropShadowEffect>
 #include <QtCore/QPersistentModelIndex>
+#include <QtCore/QVector>
 
 class GraphicsEdgeItem;
 class QNodeEditorEdgeModel;
@@ -18,6 +19,14 @@ public:
 #endif
 
     QPen _pen {QColor("#00FF00")};
+
+    // Resolved from the model, refreshed on dataChanged
+    QPen m_Pen;
+
+    // Set by the router, empty for bezier edges
+    QVector<QPointF> m_lRoute;
+    QRectF           m_RouteBounds;
+    quint64          m_RouteSerial {0};
     QPointF _start;
     QPointF _stop;
     qreal  _factor;
@@ -0,0 +1,349 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "graphicsedgerouter_p.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+#if QT_VERSION < 0x050700
+//Q_FOREACH is deprecated and Qt CoW containers are detached on C++11 for loops
+template<typename T>
+const T& qAsConst(const T& v)
+{
+    return const_cast<const T&>(v);
+}
+#endif
+
+// Distance kept between the routes and the nodes
+static const qreal route_margin = 10.0;
+
+// Length of the horizontal segment at each end, must be > route_margin
+static const qreal route_stub = 15.0;
+
+// Cost of a bend, in scene units
+static const qreal route_bend = 40.0;
+
+// Obstacles avoided by a route, the grid has up to (2n+4)^2 points
+static const int route_max_obstacles = 64;
+
+class EdgeRouterPrivate final : public QObject
+{
+    Q_OBJECT
+public:
+    QThreadPool m_Pool;
+
+    EdgeRouter::Callback m_Callback;
+
+    bool m_IsBusy {false};
+
+    QVector<QRectF> m_lPendingObstacles;
+    QHash<int, EdgeRouteRequest> m_hPending;
+
+    QMutex m_Mutex;
+    QVector<EdgeRoute> m_lResults;
+
+    // Helpers
+    void dispatch(const QVector<QRectF>& obstacles, const QVector<EdgeRouteRequest>& requests);
+
+public Q_SLOTS:
+    void slotFinished();
+};
+
+class EdgeRouterTask final : public QRunnable
+{
+public:
+    EdgeRouterTask(EdgeRouterPrivate* d, const QVector<QRectF>& o, const QVector<EdgeRouteRequest>& r)
+        : d_ptr(d), m_lObstacles(o), m_lRequests(r) {}
+
+    virtual void run() override;
+
+private:
+    EdgeRouterPrivate* d_ptr;
+    const QVector<QRectF> m_lObstacles;
+    const QVector<EdgeRouteRequest> m_lRequests;
+};
+
+EdgeRouter::EdgeRouter(const Callback& callback) : d_ptr(new EdgeRouterPrivate)
+{
+    d_ptr->m_Callback = callback;
+    d_ptr->m_Pool.setMaxThreadCount(1);
+}
+
+EdgeRouter::~EdgeRouter()
+{
+    d_ptr->m_Pool.waitForDone();
+    delete d_ptr;
+}
+
+void EdgeRouter::route(const QVector<QRectF>& obstacles, const QVector<EdgeRouteRequest>& requests)
+{
+    if (requests.isEmpty())
+        return;
+
+    if (!d_ptr->m_IsBusy) {
+        d_ptr->dispatch(obstacles, requests);
+        return;
+    }
+
+    d_ptr->m_lPendingObstacles = obstacles;
+
+    for (const auto& r : requests)
+        d_ptr->m_hPending[r.m_Row] = r;
+}
+
+void EdgeRouterPrivate::dispatch(const QVector<QRectF>& obstacles, const QVector<EdgeRouteRequest>& requests)
+{
+    m_IsBusy = true;
+    m_Pool.start(new EdgeRouterTask(this, obstacles, requests));
+}
+
+void EdgeRouterTask::run()
+{
+    QVector<EdgeRoute> results;
+    results.reserve(m_lRequests.size());
+
+    for (const auto& r : m_lRequests) {
+        results << EdgeRoute {
+            r.m_Row,
+            r.m_Serial,
+            EdgeRouter::computeRoute(m_lObstacles, r.m_Source, r.m_Sink)
+        };
+    }
+
+    QMutexLocker l(&d_ptr->m_Mutex);
+    d_ptr->m_lResults = results;
+
+    QMetaObject::invokeMethod(d_ptr, "slotFinished", Qt::QueuedConnection);
+}
+
+void EdgeRouterPrivate::slotFinished()
+{
+    QVector<EdgeRoute> results;
+
+    {
+        QMutexLocker l(&m_Mutex);
+        results.swap(m_lResults);
+    }
+
+    m_IsBusy = false;
+
+    if (!m_hPending.isEmpty()) {
+        const QVector<EdgeRouteRequest> requests = m_hPending.values().toVector();
+        m_hPending.clear();
+        dispatch(m_lPendingObstacles, requests);
+    }
+
+    m_Callback(results);
+}
+
+QVector<QPointF> EdgeRouter::computeRoute(const QVector<QRectF>& obstacles, const QPointF& source, const QPointF& sink)
+{
+    const QPointF start(source.x() + route_stub, source.y());
+    const QPointF end  (sink.x()   - route_stub, sink.y()  );
+
+    // Only consider the nodes around the endpoints. It is grown once so the
+    // route can go around the nodes touching the window.
+    const QRectF core = QRectF(start, end).normalized();
+
+    QRectF window = core.adjusted(
+        -4*route_stub, -4*route_stub, 4*route_stub, 4*route_stub
+    );
+
+    // Manhattan distance between an obstacle and the endpoints box
+    const auto distance = [&core](const QRectF& r) {
+        const qreal dx = std::max(qreal(0), std::max(core.left() - r.right(), r.left() - core.right()));
+        const qreal dy = std::max(qreal(0), std::max(core.top() - r.bottom(), r.top() - core.bottom()));
+        return dx + dy;
+    };
+
+    QVector<QRectF> blocks;
+
+    for (int pass = 0; pass < 2; pass++) {
+        blocks.clear();
+
+        for (const auto& o : obstacles) {
+            const QRectF r = o.adjusted(-route_margin, -route_margin, route_margin, route_margin);
+
+            if (r.intersects(window))
+                blocks << r;
+        }
+
+        // The grid is quadratic in the number of obstacles, only keep the
+        // closest ones. The route may cross the others.
+        if (blocks.size() > route_max_obstacles) {
+            std::nth_element(blocks.begin(), blocks.begin() + route_max_obstacles, blocks.end(),
+                [&distance](const QRectF& a, const QRectF& b) {
+                    return distance(a) < distance(b);
+            });
+
+            blocks.resize(route_max_obstacles);
+        }
+
+        QRectF grown = window;
+
+        for (const auto& r : qAsConst(blocks))
+            grown |= r;
+
+        window = grown.adjusted(-route_margin, -route_margin, route_margin, route_margin);
+    }
+
+    // The grid lines
+    QVector<qreal> xs {start.x(), end.x(), window.left(), window.right()};
+    QVector<qreal> ys {start.y(), end.y(), window.top(), window.bottom()};
+
+    for (const auto& r : qAsConst(blocks)) {
+        xs << r.left() << r.right();
+        ys << r.top() << r.bottom();
+    }
+
+    std::sort(xs.begin(), xs.end());
+    std::sort(ys.begin(), ys.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    const int nx = xs.size(), ny = ys.size();
+
+    // Strictly inside a block, the sides themselves can be used
+    QVector<bool> blockedPoint(nx * ny, false);
+    QVector<bool> blockedH    (nx * ny, false); // from (i,j) to (i+1,j)
+    QVector<bool> blockedV    (nx * ny, false); // from (i,j) to (i,j+1)
+
+    for (const auto& r : qAsConst(blocks)) {
+        const int x0 = std::lower_bound(xs.constBegin(), xs.constEnd(), r.left  ()) - xs.constBegin();
+        const int x1 = std::lower_bound(xs.constBegin(), xs.constEnd(), r.right ()) - xs.constBegin();
+        const int y0 = std::lower_bound(ys.constBegin(), ys.constEnd(), r.top   ()) - ys.constBegin();
+        const int y1 = std::lower_bound(ys.constBegin(), ys.constEnd(), r.bottom()) - ys.constBegin();
+
+        for (int j = y0; j <= y1; j++) {
+            for (int i = x0; i <= x1; i++) {
+                const bool innerX = i > x0 && i < x1;
+                const bool innerY = j > y0 && j < y1;
+
+                if (innerX && innerY)
+                    blockedPoint[j*nx + i] = true;
+
+                if (i < x1 && innerY)
+                    blockedH[j*nx + i] = true;
+
+                if (j < y1 && innerX)
+                    blockedV[j*nx + i] = true;
+            }
+        }
+    }
+
+    const int si = std::lower_bound(xs.constBegin(), xs.constEnd(), start.x()) - xs.constBegin();
+    const int sj = std::lower_bound(ys.constBegin(), ys.constEnd(), start.y()) - ys.constBegin();
+    const int ei = std::lower_bound(xs.constBegin(), xs.constEnd(), end.x()  ) - xs.constBegin();
+    const int ej = std::lower_bound(ys.constBegin(), ys.constEnd(), end.y()  ) - ys.constBegin();
+
+    if (blockedPoint[sj*nx + si] || blockedPoint[ej*nx + ei])
+        return {};
+
+    // A*, the state is the grid point and the direction it was reached from
+    // (0 horizontal, 1 vertical) so bends can be penalized
+    const int stateCount = nx * ny * 2;
+
+    QVector<qreal> cost  (stateCount, std::numeric_limits<qreal>::max());
+    QVector<int>   parent(stateCount, -1);
+
+    const auto heuristic = [&](int i, int j) {
+        return std::abs(xs[i] - end.x()) + std::abs(ys[j] - end.y());
+    };
+
+    typedef std::pair<qreal, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    // The route leaves the source horizontally
+    const int startState = (sj*nx + si) * 2;
+    cost[startState] = 0;
+    open.push({heuristic(si, sj), startState});
+
+    int goal = -1;
+
+    while (!open.empty()) {
+        const Entry top = open.top();
+        open.pop();
+
+        const int state = top.second;
+        const int point = state / 2;
+        const int dir   = state % 2;
+        const int i     = point % nx;
+        const int j     = point / nx;
+
+        if (top.first > cost[state] + heuristic(i, j))
+            continue;
+
+        // Arriving vertically already paid for the last bend
+        if (i == ei && j == ej) {
+            goal = state;
+            break;
+        }
+
+        const auto relax = [&](int ni, int nj, int ndir) {
+            const int np = nj*nx + ni;
+
+            if (blockedPoint[np])
+                return;
+
+            qreal c = cost[state] + std::abs(xs[ni] - xs[i]) + std::abs(ys[nj] - ys[j])
+                + (ndir != dir ? route_bend : 0);
+
+            // Penalize arriving vertically, a bend is needed at the end
+            if (ni == ei && nj == ej && ndir != 0)
+                c += route_bend;
+
+            const int ns = np*2 + ndir;
+
+            if (c < cost[ns]) {
+                cost[ns]   = c;
+                parent[ns] = state;
+                open.push({c + heuristic(ni, nj), ns});
+            }
+        };
+
+        if (i > 0      && !blockedH[j*nx + i - 1]) relax(i - 1, j, 0);
+        if (i < nx - 1 && !blockedH[j*nx + i    ]) relax(i + 1, j, 0);
+        if (j > 0      && !blockedV[(j-1)*nx + i]) relax(i, j - 1, 1);
+        if (j < ny - 1 && !blockedV[j*nx + i    ]) relax(i, j + 1, 1);
+    }
+
+    if (goal == -1)
+        return {};
+
+    QVector<QPointF> points {sink};
+
+    // Merge the collinear segments
+    const auto append = [&points](const QPointF& pt) {
+        if (points.size() >= 2) {
+            const QPointF& a = points[points.size() - 2];
+            const QPointF& b = points.last();
+
+            if ((a.x() == b.x() && b.x() == pt.x()) || (a.y() == b.y() && b.y() == pt.y())) {
+                points.last() = pt;
+                return;
+            }
+        }
+
+        points << pt;
+    };
+
+    for (int s = goal; s != -1; s = parent[s]) {
+        const int p = s / 2;
+        append(QPointF(xs[p % nx], ys[p / nx]));
+    }
+
+    append(source);
+
+    std::reverse(points.begin(), points.end());
+
+    return points;
+}
+
+#include "graphicsedgerouter.moc"
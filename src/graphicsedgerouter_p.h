@@ -0,0 +1,62 @@
+#ifndef GRAPHICS_EDGE_ROUTER_P_H
+#define GRAPHICS_EDGE_ROUTER_P_H
+
+#include <QtCore/QPointF>
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+
+#include <functional>
+
+class EdgeRouterPrivate;
+
+struct EdgeRouteRequest final
+{
+    int     m_Row;
+    quint64 m_Serial;
+    QPointF m_Source;
+    QPointF m_Sink;
+};
+
+struct EdgeRoute final
+{
+    int              m_Row;
+    quint64          m_Serial;
+    QVector<QPointF> m_lPoints;
+};
+
+/**
+ * Compute orthogonal edge routes avoiding the nodes.
+ *
+ * The routing itself happens on a worker thread. There is at most one batch
+ * in flight, the requests made in the meantime are merged (the last one for
+ * a row wins) and sent once it is done. The callback is invoked on the
+ * thread owning the router.
+ */
+class EdgeRouter final
+{
+public:
+    typedef std::function<void(const QVector<EdgeRoute>&)> Callback;
+
+    explicit EdgeRouter(const Callback& callback);
+    ~EdgeRouter();
+
+    void route(const QVector<QRectF>& obstacles, const QVector<EdgeRouteRequest>& requests);
+
+    /**
+     * A* over the grid formed by the (inflated) obstacle sides and the
+     * endpoints. The route leaves the source to the right and enters the
+     * sink from the left. Returns an empty vector when there is no route.
+     *
+     * Only the obstacles closest to the endpoints are avoided, so the grid
+     * size doesn't depend on the scene size.
+     *
+     * This is reentrant.
+     */
+    static QVector<QPointF> computeRoute(const QVector<QRectF>& obstacles,
+        const QPointF& source, const QPointF& sink);
+
+private:
+    EdgeRouterPrivate* d_ptr;
+};
+
+#endif
@@ -18,12 +18,14 @@
 #include <algorithm>
 
 #include "graphicsnode_p.h"
+#include "graphicsnodeexport_p.h"
 
 #include "graphicsbezieredge.hpp"
 #include "graphicsnodesocket.hpp"
 #include "graphicsnodesocket_p.h"
 
 #include "qnodeeditorsocketmodel.h"
+#include "graphicsnodescene.hpp"
 
 #if QT_VERSION < 0x050700
 //Q_FOREACH is deprecated and Qt CoW containers are detached on C++11 for loops
@@ -41,8 +43,8 @@ public:
 
     int width() const;
 
-private:
-    GraphicsNodePrivate* d_ptr;
+    // Bound when the node is realized
+    GraphicsNodePrivate* d_ptr {nullptr};
 
 protected:
     virtual void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
@@ -73,11 +75,18 @@ public:
     constexpr static const qreal _pen_width = 1.0;
     constexpr static const qreal _socket_size = 6.0;
 
-    NodeGraphicsItem* m_pGraphicsItem;
+    NodeGraphicsItem* m_pGraphicsItem {nullptr};
 
     bool _changed {false};
 
+    // The record, this is all that is kept for the unrealized nodes
+    QPointF m_Pos  {0, 0};
     QSizeF m_Size {150, 120};
+    QPixmap m_Decoration;
+
+    // Resolved style, refreshed by the model on dataChanged
+    QBrush m_Background;
+    QColor m_Foreground {Qt::white};
 
     QPen _pen_default  {QColor("#7F000000")};
     QPen _pen_selected {QColor("#FFFF36A7")};
@@ -101,6 +110,12 @@ public:
     // Helpers
     void updateGeometry();
     void updateSizeHints();
+    void updateSocketAnchors();
+    void setPos(const QPointF& pos);
+    void notifyResize(const QSizeF& old);
+    void updateStyle();
+    void realize(NodeItemPool* pool);
+    void unrealize(NodeItemPool* pool);
 
     GraphicsNode* q_ptr;
 };
@@ -115,14 +130,27 @@ constexpr const qreal GraphicsNodePrivate::_lr_padding;
 constexpr const qreal GraphicsNodePrivate::_pen_width;
 constexpr const qreal GraphicsNodePrivate::_socket_size;
 
+// The sockets are the rows below the node, nested rows included. They are
+// visited depth first, which is also the order they are laid out in
+template<typename F>
+static void forEachSocketRow(const QAbstractItemModel* m, const QModelIndex& parent, const F& f)
+{
+    const int count = m->rowCount(parent);
+
+    for (int i = 0; i < count; i++) {
+        const auto idx = m->index(i, 0, parent);
+        f(idx);
+        forEachSocketRow(m, idx, f);
+    }
+}
+
 class NodeTitle : public QGraphicsTextItem
 {
 public:
-    explicit NodeTitle(GraphicsNodePrivate* parent) : QGraphicsTextItem(parent->m_pGraphicsItem),
-    d_ptr(parent) {}
+    explicit NodeTitle(NodeGraphicsItem* parent) : QGraphicsTextItem(parent) {}
 
-private:
-    GraphicsNodePrivate* d_ptr;
+    // Bound when the node is realized
+    GraphicsNodePrivate* d_ptr {nullptr};
 
 protected:
     virtual void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) override;
@@ -177,48 +205,235 @@ void NodeTitle::keyPressEvent(QKeyEvent *event)
 GraphicsNode::GraphicsNode(QNodeEditorSocketModel* model, const QPersistentModelIndex& index, QGraphicsItem *parent)
 : QObject(nullptr), d_ptr(new GraphicsNodePrivate(this))
 {
+    Q_UNUSED(parent)
+
     d_ptr->m_pModel = model;
     d_ptr->m_Index = index;
 
-    d_ptr->m_pGraphicsItem = new NodeGraphicsItem(parent);
-    d_ptr->m_pGraphicsItem->d_ptr = d_ptr;
-    d_ptr->m_pGraphicsItem->q_ptr = this;
-
-    d_ptr->_deco_item = new QGraphicsPixmapItem(d_ptr->m_pGraphicsItem);
-    d_ptr->_deco_item->setPos(2, 4);
-
-    d_ptr->_title_item = new NodeTitle(d_ptr);
-
     for (auto p : {
       &d_ptr->_pen_default, &d_ptr->_pen_selected,
       &d_ptr->_pen_default, &d_ptr->_pen_selected
     })
         p->setWidth(0);
 
-    d_ptr->m_pGraphicsItem->setFlag(QGraphicsItem::ItemIsMovable);
-    d_ptr->m_pGraphicsItem->setFlag(QGraphicsItem::ItemIsSelectable);
-    d_ptr->m_pGraphicsItem->setFlag(QGraphicsItem::ItemSendsGeometryChanges);
+    d_ptr->updateStyle();
 
-    // The close button
-    d_ptr->_close_item = new CloseButton(d_ptr->m_pGraphicsItem);
-    d_ptr->_close_item->setPos(d_ptr->m_Size.width() - d_ptr->_close_item->width(), 0);
+    // The graphics items are created by realize()
+}
 
-    d_ptr->_title_item->setDefaultTextColor(Qt::white);
+void GraphicsNode::
+snapshot(SceneSnapshot& s) const
+{
+    s.m_lNodes << SceneSnapshot::Node {
+        rect(),
+        d_ptr->_brush_title,
+        d_ptr->m_Background,
+        d_ptr->m_pGraphicsItem && d_ptr->m_pGraphicsItem->isSelected() ?
+            d_ptr->_pen_selected : d_ptr->_pen_default,
+        d_ptr->m_Foreground,
+        d_ptr->m_Index.data().toString(),
+        d_ptr->m_Decoration.toImage()
+    };
 
-    d_ptr->_title_item->setPos(20, 0);
-    d_ptr->_title_item->setTextWidth(
-        d_ptr->m_Size.width()
-        - 2*d_ptr->_lr_padding
-        - d_ptr->_close_item->width()
-        - 20 //icon
-    );
+    const auto m = d_ptr->m_pModel;
+
+    forEachSocketRow(m, d_ptr->m_Index, [m, &s](const QModelIndex& idx) {
+        if (const auto sock = m->getSinkSocket(idx))
+            sock->snapshot(s);
+
+        if (const auto sock = m->getSourceSocket(idx))
+            sock->snapshot(s);
+    });
+}
+
+void GraphicsNode::
+updateStyle()
+{
+    d_ptr->updateStyle();
+}
+
+void GraphicsNodePrivate::
+updateStyle()
+{
+    const auto bgVar = m_Index.data(Qt::BackgroundRole);
+    const auto fgVar = m_Index.data(Qt::ForegroundRole);
+
+    m_Background = bgVar.canConvert<QBrush>() ?
+        qvariant_cast<QBrush>(bgVar) : _brush_background;
+
+    m_Foreground = fgVar.canConvert<QColor>() ?
+        qvariant_cast<QColor>(fgVar) : Qt::white;
+
+    if (!m_pGraphicsItem)
+        return;
+
+    _title_item->setDefaultTextColor(m_Foreground);
+    m_pGraphicsItem->update();
+}
+
+void GraphicsNode::
+realize(NodeItemPool* pool)
+{
+    d_ptr->realize(pool);
+}
+
+void GraphicsNode::
+unrealize(NodeItemPool* pool)
+{
+    d_ptr->unrealize(pool);
+}
+
+bool GraphicsNode::
+isRealized() const
+{
+    return d_ptr->m_pGraphicsItem;
+}
+
+void GraphicsNodePrivate::
+realize(NodeItemPool* pool)
+{
+    if (m_pGraphicsItem)
+        return;
+
+    NodeItemPool::NodeItems items;
+
+    if (pool && !pool->m_lNodes.isEmpty())
+        items = pool->m_lNodes.takeLast();
+    else {
+        items.m_pNode = new NodeGraphicsItem(nullptr);
+
+        items.m_pDeco = new QGraphicsPixmapItem(items.m_pNode);
+        items.m_pDeco->setPos(2, 4);
+
+        items.m_pTitle = new NodeTitle(items.m_pNode);
+        items.m_pTitle->setPos(20, 0);
+
+        // The close button
+        items.m_pClose = new CloseButton(items.m_pNode);
+
+        items.m_pNode->setFlag(QGraphicsItem::ItemIsMovable);
+        items.m_pNode->setFlag(QGraphicsItem::ItemIsSelectable);
 
 #if 0
-    d_ptr->_effect->setBlurRadius(13.0);
-    d_ptr->_effect->setColor(QColor("#99121212"));
+        _effect->setBlurRadius(13.0);
+        _effect->setColor(QColor("#99121212"));
 
-    d_ptr->m_pGraphicsItem->setGraphicsEffect(d_ptr->_effect);
+        items.m_pNode->setGraphicsEffect(_effect);
 #endif
+    }
+
+    m_pGraphicsItem = items.m_pNode;
+    _deco_item      = items.m_pDeco;
+    _title_item     = items.m_pTitle;
+    _close_item     = items.m_pClose;
+
+    m_pGraphicsItem->d_ptr = this;
+    m_pGraphicsItem->q_ptr = q_ptr;
+    _title_item->d_ptr     = this;
+    _close_item->d_ptr     = this;
+
+    // Restore the state from the record. Moving the item would notify the
+    // model, which has nothing new to learn.
+    m_pGraphicsItem->setFlag(QGraphicsItem::ItemSendsGeometryChanges, false);
+    m_pGraphicsItem->setPos(m_Pos);
+    m_pGraphicsItem->setFlag(QGraphicsItem::ItemSendsGeometryChanges);
+
+    _title_item->setDefaultTextColor(m_Foreground);
+    _title_item->setPlainText(m_Index.data().toString());
+    _deco_item->setPixmap(m_Decoration);
+
+    if (auto scene = m_pModel->scene())
+        scene->addItem(m_pGraphicsItem);
+
+    forEachSocketRow(m_pModel, m_Index, [this, pool](const QModelIndex& idx) {
+        if (const auto s = m_pModel->getSinkSocket(idx))
+            s->d_ptr->realize(m_pGraphicsItem, pool);
+
+        if (const auto s = m_pModel->getSourceSocket(idx))
+            s->d_ptr->realize(m_pGraphicsItem, pool);
+    });
+
+    _changed = true;
+    updateGeometry();
+}
+
+void GraphicsNodePrivate::
+unrealize(NodeItemPool* pool)
+{
+    // The central widget is user state, those nodes stay realized
+    if ((!m_pGraphicsItem) || _central_proxy)
+        return;
+
+    if (auto scene = m_pGraphicsItem->scene()) {
+        m_pGraphicsItem->setSelected(false);
+        scene->removeItem(m_pGraphicsItem);
+    }
+
+    forEachSocketRow(m_pModel, m_Index, [this, pool](const QModelIndex& idx) {
+        if (const auto s = m_pModel->getSinkSocket(idx))
+            s->d_ptr->unrealize(pool);
+
+        if (const auto s = m_pModel->getSourceSocket(idx))
+            s->d_ptr->unrealize(pool);
+    });
+
+    m_pGraphicsItem->d_ptr = nullptr;
+    m_pGraphicsItem->q_ptr = nullptr;
+    _title_item->d_ptr     = nullptr;
+    _close_item->d_ptr     = nullptr;
+
+    m_pGraphicsItem->setZValue(0);
+
+    if (pool)
+        pool->m_lNodes << NodeItemPool::NodeItems {
+            m_pGraphicsItem, _deco_item, _title_item, _close_item
+        };
+    else
+        delete m_pGraphicsItem; // also deletes the children
+
+    m_pGraphicsItem = nullptr;
+    _deco_item      = nullptr;
+    _title_item     = nullptr;
+    _close_item     = nullptr;
+}
+
+void GraphicsNodePrivate::
+setPos(const QPointF& pos)
+{
+    // The item notifies the model itself from itemChange()
+    if (m_pGraphicsItem) {
+        m_pGraphicsItem->setPos(pos);
+        return;
+    }
+
+    m_Pos = pos;
+
+    if (auto m = const_cast<QAbstractItemModel*>(m_Index.model()))
+        m->setData(m_Index, q_ptr->rect(), Qt::SizeHintRole);
+
+    updateSocketAnchors();
+}
+
+void GraphicsNodePrivate::
+notifyResize(const QSizeF& old)
+{
+    // Like setPos(), the model reroutes and indexes the node from its rect
+    if (m_Size == old)
+        return;
+
+    if (auto m = const_cast<QAbstractItemModel*>(m_Index.model()))
+        m->setData(m_Index, q_ptr->rect(), Qt::SizeHintRole);
+}
+
+NodeItemPool::
+~NodeItemPool()
+{
+    // The title, decoration and close button are children of the node item
+    for (const auto& i : qAsConst(m_lNodes))
+        delete i.m_pNode;
+
+    for (auto i : qAsConst(m_lSockets))
+        delete i;
 }
 
 
@@ -228,6 +443,9 @@ setTitle(const QString &title)
     if (auto m = const_cast<QAbstractItemModel*>(d_ptr->m_Index.model()))
         m->setData(d_ptr->m_Index, title, Qt::DisplayRole);
 
+    if (!d_ptr->m_pGraphicsItem)
+        return;
+
     d_ptr->m_pGraphicsItem->prepareGeometryChange();
     d_ptr->_title_item->setPlainText(d_ptr->m_Index.data().toString());
 }
@@ -238,13 +456,15 @@ setDecoration(const QVariant& deco)
     if (!deco.isValid())
         return;
 
-    if (deco.canConvert<QIcon>()) {
-        const auto px = qvariant_cast<QIcon>(deco).pixmap(16,16);
-        d_ptr->_deco_item->setPixmap(px);
-    }
-    else if (deco.canConvert<QPixmap>()) {
-        d_ptr->_deco_item->setPixmap(qvariant_cast<QPixmap>(deco));
-    }
+    if (deco.canConvert<QIcon>())
+        d_ptr->m_Decoration = qvariant_cast<QIcon>(deco).pixmap(16,16);
+    else if (deco.canConvert<QPixmap>())
+        d_ptr->m_Decoration = qvariant_cast<QPixmap>(deco);
+    else
+        return;
+
+    if (d_ptr->_deco_item)
+        d_ptr->_deco_item->setPixmap(d_ptr->m_Decoration);
 }
 
 void GraphicsNode::
@@ -273,12 +493,8 @@ setForeground(const QPen& pen)
     if (auto m = const_cast<QAbstractItemModel*>(d_ptr->m_Index.model()))
         m->setData(d_ptr->m_Index, pen, Qt::ForegroundRole);
 
-    //FIXME this should be removed once dataChanged really reload it
-    const auto fgVar = d_ptr->m_Index.data(Qt::ForegroundRole);
-
-    d_ptr->_title_item->setDefaultTextColor(fgVar.canConvert<QColor>() ?
-        qvariant_cast<QColor>(fgVar) : Qt::white
-    );
+    //FIXME this should be removed once all models forward the dataChanged
+    d_ptr->updateStyle();
 
     // Update the palette
     if (d_ptr->_central_proxy) {
@@ -294,12 +510,8 @@ setForeground(const QColor& pen)
     if (auto m = const_cast<QAbstractItemModel*>(d_ptr->m_Index.model()))
         m->setData(d_ptr->m_Index, pen, Qt::ForegroundRole);
 
-    //FIXME this should be removed once dataChanged really reload it
-    const auto fgVar = d_ptr->m_Index.data(Qt::ForegroundRole);
-
-    d_ptr->_title_item->setDefaultTextColor(fgVar.canConvert<QColor>() ?
-        qvariant_cast<QColor>(fgVar) : Qt::white
-    );
+    //FIXME this should be removed once all models forward the dataChanged
+    d_ptr->updateStyle();
 
     // Update the palette
     if (d_ptr->_central_proxy) {
@@ -355,7 +567,7 @@ QRectF GraphicsNode::
 rect() const
 {
     return QRectF(
-        d_ptr->m_pGraphicsItem->pos(),
+        d_ptr->m_Pos,
         d_ptr->m_Size
     );
 }
@@ -369,7 +581,7 @@ graphicsItem() const
 GraphicsNode::
 ~GraphicsNode()
 {
-    Q_ASSERT(!d_ptr->m_pGraphicsItem->scene());
+    Q_ASSERT((!d_ptr->m_pGraphicsItem) || !d_ptr->m_pGraphicsItem->scene());
     // The widget proxy doesn't own the widget unless specified
     if (d_ptr->_central_proxy) {
         delete d_ptr->_central_proxy;
@@ -404,6 +616,28 @@ boundingRect() const
 
 void NodeGraphicsItem::
 paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
+{
+    paintShape(painter, d_ptr->m_Size, d_ptr->_brush_title, d_ptr->m_Background,
+        isSelected() ? d_ptr->_pen_selected : d_ptr->_pen_default
+    );
+
+    // debug bounding box
+#if 0
+    QPen debugPen = QPen(QColor(Qt::red));
+    debugPen.setWidth(0);
+    auto r = boundingRect();
+    painter->setPen(debugPen);
+    painter->setBrush(Qt::NoBrush);
+    painter->drawRect(r);
+
+    painter->drawPoint(0,0);
+#endif
+}
+
+
+void NodeGraphicsItem::
+paintShape(QPainter *painter, const QSizeF& size, const QBrush& title,
+    const QBrush& content, const QPen& outline)
 {
     const qreal edge_size = 10.0;
     const qreal title_height = 20.0;
@@ -411,47 +645,30 @@ paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
     // path for the caption of this node
     QPainterPath path_title;
     path_title.setFillRule(Qt::WindingFill);
-    path_title.addRoundedRect(QRect(0, 0, d_ptr->m_Size.width(), title_height), edge_size, edge_size);
+    path_title.addRoundedRect(QRect(0, 0, size.width(), title_height), edge_size, edge_size);
     path_title.addRect(0, title_height - edge_size, edge_size, edge_size);
-    path_title.addRect(d_ptr->m_Size.width() - edge_size, title_height - edge_size, edge_size, edge_size);
+    path_title.addRect(size.width() - edge_size, title_height - edge_size, edge_size, edge_size);
     painter->setPen(Qt::NoPen);
-    painter->setBrush(d_ptr->_brush_title);
+    painter->setBrush(title);
     painter->drawPath(path_title.simplified());
 
     // path for the content of this node
     QPainterPath path_content;
     path_content.setFillRule(Qt::WindingFill);
-    path_content.addRoundedRect(QRect(0, title_height, d_ptr->m_Size.width(), d_ptr->m_Size.height() - title_height), edge_size, edge_size);
+    path_content.addRoundedRect(QRect(0, title_height, size.width(), size.height() - title_height), edge_size, edge_size);
     path_content.addRect(0, title_height, edge_size, edge_size);
-    path_content.addRect(d_ptr->m_Size.width() - edge_size, title_height, edge_size, edge_size);
+    path_content.addRect(size.width() - edge_size, title_height, edge_size, edge_size);
     painter->setPen(Qt::NoPen);
-
-    const auto bgVar = d_ptr->m_Index.data(Qt::BackgroundRole);
-
-    painter->setBrush(bgVar.canConvert<QBrush>() ?
-        qvariant_cast<QBrush>(bgVar) : d_ptr->_brush_background
-    );
+    painter->setBrush(content);
 
     painter->drawPath(path_content.simplified());
 
     // path for the outline
     QPainterPath path_outline = QPainterPath();
-    path_outline.addRoundedRect(QRect(0, 0, d_ptr->m_Size.width(), d_ptr->m_Size.height()), edge_size, edge_size);
-    painter->setPen(isSelected() ? d_ptr->_pen_selected : d_ptr->_pen_default);
+    path_outline.addRoundedRect(QRect(0, 0, size.width(), size.height()), edge_size, edge_size);
+    painter->setPen(outline);
     painter->setBrush(Qt::NoBrush);
     painter->drawPath(path_outline.simplified());
-
-    // debug bounding box
-#if 0
-    QPen debugPen = QPen(QColor(Qt::red));
-    debugPen.setWidth(0);
-    auto r = boundingRect();
-    painter->setPen(debugPen);
-    painter->setBrush(Qt::NoBrush);
-    painter->drawRect(r);
-
-    painter->drawPoint(0,0);
-#endif
 }
 
 
@@ -482,44 +699,61 @@ setSize(const QPointF size)
 void GraphicsNode::
 setSize(const QSizeF size)
 {
+    const QSizeF old = d_ptr->m_Size;
+
     d_ptr->m_Size = {
         std::max(d_ptr->m_MinSize.width() , size.width ()),
         std::max(d_ptr->m_MinSize.height(), size.height())
     };
 
     d_ptr->_changed = true;
-    d_ptr->m_pGraphicsItem->prepareGeometryChange();
+    if (d_ptr->m_pGraphicsItem)
+        d_ptr->m_pGraphicsItem->prepareGeometryChange();
     d_ptr->updateGeometry();
+    d_ptr->notifyResize(old);
 }
 
 void GraphicsNode::
 setRect(const qreal x, const qreal y, const qreal width, const qreal height)
 {
-    graphicsItem()->setPos(x, y);
+    d_ptr->setPos(QPointF(x, y));
     setSize(width, height);
 }
 
 void GraphicsNode::
 setRect(const QRectF size)
 {
-    graphicsItem()->setPos(size.topLeft());
+    d_ptr->setPos(size.topLeft());
     setSize(size.size());
 }
 
 QVariant NodeGraphicsItem::
 itemChange(GraphicsItemChange change, const QVariant &value)
 {
+    // Recycled item, it is not bound to a node anymore
+    if (!d_ptr)
+        return QGraphicsItem::itemChange(change, value);
+
     #pragma GCC diagnostic push
     #pragma GCC diagnostic ignored "-Wswitch"
     switch (change) {
     case QGraphicsItem::ItemSelectedChange:
         setZValue(value.toBool() ? 1 : 0);
         break;
-    case QGraphicsItem::ItemPositionChange:
+    case QGraphicsItem::ItemPositionChange: {
+        auto m = const_cast<QAbstractItemModel*>(d_ptr->m_Index.model());
+
+        m->setData(d_ptr->m_Index, q_ptr->rect(), Qt::SizeHintRole);
+    }
+        break;
     case QGraphicsItem::ItemPositionHasChanged: {
+        d_ptr->m_Pos = value.toPointF();
+
         auto m = const_cast<QAbstractItemModel*>(d_ptr->m_Index.model());
 
         m->setData(d_ptr->m_Index, q_ptr->rect(), Qt::SizeHintRole);
+
+        d_ptr->updateSocketAnchors();
     }
         break;
 
@@ -532,9 +766,14 @@ itemChange(GraphicsItemChange change, const QVariant &value)
 
 void GraphicsNode::update()
 {
+    // The minimum size may have grown
+    const QSizeF old = d_ptr->m_Size;
+
     d_ptr->_changed = true;
-    d_ptr->m_pGraphicsItem->prepareGeometryChange();
+    if (d_ptr->m_pGraphicsItem)
+        d_ptr->m_pGraphicsItem->prepareGeometryChange();
     d_ptr->updateGeometry();
+    d_ptr->notifyResize(old);
 }
 
 QModelIndex GraphicsNode::index() const
@@ -572,28 +811,26 @@ updateGeometry()
     // compute if we have reached the minimum size
     updateSizeHints();
 
-    // close button
-    _close_item->setPos(m_Size.width() - _close_item->width(), 0);
+    if (m_pGraphicsItem) {
+        // close button
+        _close_item->setPos(m_Size.width() - _close_item->width(), 0);
 
-    // title
-    _title_item->setTextWidth(m_Size.width() - _close_item->width());
+        // title
+        _title_item->setTextWidth(m_Size.width() - _close_item->width());
+    }
 
     qreal yposSink = _top_margin;
     qreal yposSrc  = m_Size.height() - _bottom_margin;
 
-    const int count = m_pModel->rowCount(m_Index);
-
-    for (int i = 0; i < count; i++) {
-        const auto idx = m_pModel->index(i, 0, m_Index);
-
+    forEachSocketRow(m_pModel, m_Index, [&](const QModelIndex& idx) {
         // sinks
         if (const auto s = m_pModel->getSinkSocket(idx)) {
             const auto size = s->size();
 
-            s->graphicsItem()->setPos(0, yposSink + size.height()/2.0);
+            s->d_ptr->setPos({0, yposSink + size.height()/2.0});
             yposSink += size.height() + _item_padding;
 
-            s->graphicsItem()->setOpacity(s->index().flags() & Qt::ItemIsEnabled ?
+            s->d_ptr->setOpacity(s->index().flags() & Qt::ItemIsEnabled ?
                 1.0 : 0.1
             );
         }
@@ -603,14 +840,14 @@ updateGeometry()
             const auto size = s->size();
 
             yposSrc -= size.height();
-            s->graphicsItem()->setPos(m_Size.width(), yposSrc + size.height()/2.0);
+            s->d_ptr->setPos({m_Size.width(), yposSrc + size.height()/2.0});
             yposSrc -= _item_padding;
 
-            s->graphicsItem()->setOpacity(s->index().flags() & Qt::ItemIsEnabled ?
+            s->d_ptr->setOpacity(s->index().flags() & Qt::ItemIsEnabled ?
                 1.0 : 0.1
             );
         }
-    }
+    });
 
     // central widget
     if (_central_proxy) {
@@ -622,20 +859,50 @@ updateGeometry()
         });
     }
 
+    updateSocketAnchors();
+
     _changed = false;
 }
 
+void GraphicsNodePrivate::
+updateSocketAnchors()
+{
+    auto scene = m_pModel->scene();
+
+    if (!scene)
+        return;
+
+    forEachSocketRow(m_pModel, m_Index, [this, scene](const QModelIndex& idx) {
+        if (const auto s = m_pModel->getSinkSocket(idx))
+            scene->updateSocket(s, s->d_ptr->sceneAnchorPos());
+
+        if (const auto s = m_pModel->getSourceSocket(idx))
+            scene->updateSocket(s, s->d_ptr->sceneAnchorPos());
+    });
+}
+
 void GraphicsNode::
 setCentralWidget (QWidget *widget)
 {
-    if (d_ptr->_central_proxy)
+    if (d_ptr->_central_proxy) {
         delete d_ptr->_central_proxy;
+        d_ptr->_central_proxy = nullptr;
+    }
 
+    // Removing the widget only shrinks the node, it must not realize it
     if (!widget) {
-        d_ptr->m_pGraphicsItem->prepareGeometryChange();
-        d_ptr->updateGeometry();
+        if (d_ptr->m_pGraphicsItem) {
+            d_ptr->_changed = true;
+            d_ptr->m_pGraphicsItem->prepareGeometryChange();
+            d_ptr->updateGeometry();
+        }
+        return;
     }
 
+    // The widget needs a graphics item to be embedded into, it will now
+    // remain realized
+    d_ptr->realize(nullptr);
+
     d_ptr->_central_proxy = new QGraphicsProxyWidget(d_ptr->m_pGraphicsItem);
 
     // Update the palette
@@ -662,17 +929,19 @@ void GraphicsNodePrivate::
 updateSizeHints() {
     qreal min_width(0.0), min_height(_top_margin + _bottom_margin);
 
-    const int count = m_pModel->rowCount(m_Index);
+    // Both sides are stacked, the sources below the sinks
+    const auto add = [&](const GraphicsNodeSocket* s) {
+        const auto size = s->minimalSize();
 
-    // sinks
-    for (int i = 0; i < count; i++) {
-        if (const auto s = m_pModel->getSinkSocket(m_pModel->index(i, 0, m_Index))) {
-            auto size = s->minimalSize();
+        min_height += size.height() + _item_padding;
+        min_width   = std::max(size.width(), min_width);
+    };
 
-            min_height += size.height() + _item_padding;
-            min_width   = std::max(size.width(), min_width);
-        }
-    }
+    // sinks
+    forEachSocketRow(m_pModel, m_Index, [this, &add](const QModelIndex& idx) {
+        if (const auto s = m_pModel->getSinkSocket(idx))
+            add(s);
+    });
 
     // central widget
     if (_central_proxy) {
@@ -703,14 +972,10 @@ updateSizeHints() {
     }
 
     // sources
-    for (int i = 0; i < count; i++) {
-        if (const auto s = m_pModel->getSourceSocket(m_pModel->index(i, 0, m_Index))) {
-            const auto size = s->minimalSize();
-
-            min_height += size.height() + _item_padding;
-            min_width   = std::max(size.width(), min_width);
-        }
-    }
+    forEachSocketRow(m_pModel, m_Index, [this, &add](const QModelIndex& idx) {
+        if (const auto s = m_pModel->getSourceSocket(idx))
+            add(s);
+    });
 
     m_MinSize = {
         std::max(min_width, _hard_min_width  ),
@@ -719,7 +984,8 @@ updateSizeHints() {
 
     // prevent the scene from being out of sync
     if (m_Size.width() < min_width || m_Size.height() < min_height) {
-        m_pGraphicsItem->prepareGeometryChange();
+        if (m_pGraphicsItem)
+            m_pGraphicsItem->prepareGeometryChange();
 
         m_Size = {
             std::max(min_width , m_Size.width ()),
@@ -731,8 +997,7 @@ updateSizeHints() {
     }
 }
 
-CloseButton::CloseButton(NodeGraphicsItem* parent) : QGraphicsTextItem(parent),
-    d_ptr(parent->d_ptr)
+CloseButton::CloseButton(NodeGraphicsItem* parent) : QGraphicsTextItem(parent)
 {
     setDefaultTextColor(Qt::white);
     setHtml(QStringLiteral("<b>❌</b>"));
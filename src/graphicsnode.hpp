@@ -20,6 +20,8 @@ class QAbstractItemModel;
 class QNodeEditorSocketModel;
 
 class GraphicsNodePrivate;
+class NodeItemPool;
+struct SceneSnapshot;
 
 class Q_DECL_EXPORT GraphicsNode : public QObject
 {
@@ -29,8 +31,14 @@ class Q_DECL_EXPORT GraphicsNode : public QObject
     Q_OBJECT
 
 public:
+    /**
+     * The graphics item, nullptr if the node is not realized. When the view
+     * is virtualized, nodes outside of the viewport only exist as records.
+     */
     QGraphicsItem *graphicsItem() const;
 
+    bool isRealized() const;
+
     QSizeF size() const;
     QRectF rect() const;
 
@@ -74,8 +82,14 @@ private:
     virtual ~GraphicsNode();
 
     void update();
+    void updateStyle();
+    void snapshot(SceneSnapshot& s) const;
     void setIndex(const QModelIndex& idx);//FIXME HACK this is a workaround for a bug elsewhere
 
+    // Create or recycle the graphics items (pool can be nullptr)
+    void realize(NodeItemPool* pool);
+    void unrealize(NodeItemPool* pool);
+
     GraphicsNodePrivate* d_ptr;
     Q_DECLARE_PRIVATE(GraphicsNode)
 };
@@ -2,6 +2,12 @@
 #define GRAPHICS_NODE_P_H
 
 #include <QtWidgets/QGraphicsItem>
+#include <QtCore/QVector>
+
+class NodeTitle;
+class CloseButton;
+class SocketGraphicsItem;
+class QGraphicsPixmapItem;
 
 class NodeGraphicsItem : public QGraphicsItem
 {
@@ -17,12 +23,39 @@ public:
             const QStyleOptionGraphicsItem *option,
             QWidget *widget = 0) override;
 
-    GraphicsNodePrivate* d_ptr;
-    GraphicsNode* q_ptr;
+    // Also used to paint the snapshots, this has to be reentrant
+    static void paintShape(QPainter *painter, const QSizeF& size,
+            const QBrush& title, const QBrush& content, const QPen& outline);
+
+    // nullptr while the item is in the pool
+    GraphicsNodePrivate* d_ptr {nullptr};
+    GraphicsNode* q_ptr {nullptr};
 
 protected:
     virtual void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
     virtual QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
 };
 
+/**
+ * Graphics items of the nodes and sockets that are currently not realized,
+ * kept around so scrolling a virtualized scene doesn't allocate.
+ *
+ * The items in the pool are not bound to any node and not part of a scene.
+ */
+class NodeItemPool final
+{
+public:
+    ~NodeItemPool();
+
+    struct NodeItems {
+        NodeGraphicsItem    *m_pNode;
+        QGraphicsPixmapItem *m_pDeco;
+        NodeTitle           *m_pTitle;
+        CloseButton         *m_pClose;
+    };
+
+    QVector<NodeItems>           m_lNodes;
+    QVector<SocketGraphicsItem*> m_lSockets;
+};
+
 #endif
@@ -0,0 +1,129 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "graphicsnodeexport_p.h"
+
+#include <QtGui/QPainter>
+
+#include "graphicsnode_p.h"
+#include "graphicsnodesocket_p.h"
+#include "parallelfor_p.h"
+
+static void
+paintTile(QPainter *painter, const SceneSnapshot& s, const QRectF& rect)
+{
+    painter->fillRect(rect, s.m_Background);
+
+    for (const auto& g : s.m_lGrid) {
+        painter->setPen(g.m_Pen);
+        painter->drawLines(g.m_lLines);
+    }
+
+    for (const auto& e : s.m_lEdges) {
+        const qreal m = e.m_Pen.widthF();
+
+        if (!e.m_Path.controlPointRect().adjusted(-m, -m, m, m).intersects(rect))
+            continue;
+
+        painter->setPen(e.m_Pen);
+        painter->setBrush(Qt::NoBrush);
+        painter->drawPath(e.m_Path);
+    }
+
+    for (const auto& n : s.m_lNodes) {
+        if (!n.m_Rect.adjusted(-1, -1, 1, 1).intersects(rect))
+            continue;
+
+        painter->save();
+        painter->translate(n.m_Rect.topLeft());
+
+        NodeGraphicsItem::paintShape(painter, n.m_Rect.size(),
+            n.m_TitleBrush, n.m_Background, n.m_Outline
+        );
+
+        if (!n.m_Decoration.isNull())
+            painter->drawImage(QPointF(2, 4), n.m_Decoration);
+
+        // Same position as the title item, minus the close button
+        painter->setPen(n.m_Foreground);
+        painter->drawText(
+            QRectF(20, 0, n.m_Rect.width() - 40, 20),
+            Qt::AlignLeft | Qt::AlignVCenter | Qt::TextSingleLine,
+            n.m_Title
+        );
+
+        painter->restore();
+    }
+
+    const QPen circle(PEN_COLOR_CIRCLE, 0);
+
+    for (const auto& sock : s.m_lSockets) {
+        if (!sock.m_Bounds.intersects(rect))
+            continue;
+
+        painter->save();
+        painter->translate(sock.m_Anchor);
+        painter->setOpacity(sock.m_Opacity);
+
+        GraphicsNodeSocketPrivate::paintSocket(painter, sock.m_Type, circle,
+            sock.m_Brush, sock.m_TextPen, sock.m_Text, sock.m_Indent
+        );
+
+        painter->restore();
+    }
+}
+
+QImage GraphicsNodeExport::
+render(const SceneSnapshot& snapshot, const QRectF& area, qreal scale, int tileSize)
+{
+    const QSize size = (area.size() * scale).toSize();
+
+    if (size.isEmpty() || tileSize <= 0)
+        return {};
+
+    QImage result(size, QImage::Format_ARGB32_Premultiplied);
+
+    // Out of memory or over the QImage size limit
+    if (result.isNull())
+        return {};
+
+    const int cols = (size.width () + tileSize - 1) / tileSize;
+    const int rows = (size.height() + tileSize - 1) / tileSize;
+
+    QVector<QImage> tiles(cols * rows);
+    QImage *out = tiles.data();
+
+    parallelFor(cols * rows, [&](int i) {
+        const QRect px = QRect(
+            (i % cols) * tileSize, (i / cols) * tileSize, tileSize, tileSize
+        ) & QRect(QPoint(), size);
+
+        QImage tile(px.size(), QImage::Format_ARGB32_Premultiplied);
+
+        QPainter painter(&tile);
+        painter.setRenderHints(QPainter::Antialiasing |
+            QPainter::TextAntialiasing |
+            QPainter::SmoothPixmapTransform);
+
+        // tile pixels -> scene
+        painter.translate(-px.topLeft());
+        painter.scale(scale, scale);
+        painter.translate(-area.topLeft());
+
+        paintTile(&painter, snapshot, QRectF(
+            area.topLeft() + QPointF(px.topLeft()) / scale,
+            QSizeF(px.size()) / scale
+        ));
+
+        painter.end();
+
+        out[i] = tile;
+    });
+
+    QPainter painter(&result);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+
+    for (int i = 0; i < tiles.size(); i++)
+        painter.drawImage(QPoint((i % cols) * tileSize, (i / cols) * tileSize), tiles[i]);
+
+    return result;
+}
@@ -0,0 +1,71 @@
+#ifndef GRAPHICS_NODE_EXPORT_P_H
+#define GRAPHICS_NODE_EXPORT_P_H
+
+#include <QtCore/QLine>
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+#include <QtGui/QBrush>
+#include <QtGui/QImage>
+#include <QtGui/QPainterPath>
+#include <QtGui/QPen>
+
+#include "graphicsnodesocket.hpp"
+
+/**
+ * Copy of everything needed to paint the scene. It only holds implicitly
+ * shared values (and QImage instead of QPixmap), so once taken on the GUI
+ * thread, it can be painted from any thread.
+ */
+struct SceneSnapshot final
+{
+    struct Node {
+        QRectF  m_Rect;
+        QBrush  m_TitleBrush;
+        QBrush  m_Background;
+        QPen    m_Outline;
+        QColor  m_Foreground;
+        QString m_Title;
+        QImage  m_Decoration;
+    };
+
+    struct Socket {
+        QRectF                         m_Bounds;
+        QPointF                        m_Anchor;
+        GraphicsNodeSocket::SocketType m_Type;
+        QBrush                         m_Brush;
+        QPen                           m_TextPen;
+        QString                        m_Text;
+        qreal                          m_Indent;
+        qreal                          m_Opacity;
+    };
+
+    struct Edge {
+        QPainterPath m_Path;
+        QPen         m_Pen;
+    };
+
+    struct Lines {
+        QVector<QLine> m_lLines;
+        QPen           m_Pen;
+    };
+
+    QBrush          m_Background;
+    QVector<Lines>  m_lGrid; // over the background, when it isn't a tile
+    QVector<Node>   m_lNodes;
+    QVector<Socket> m_lSockets;
+    QVector<Edge>   m_lEdges;
+};
+
+namespace GraphicsNodeExport
+{
+    /**
+     * Render area of the snapshot at the given scale. The area is split into
+     * tileSize x tileSize pixel tiles painted concurrently, then stitched.
+     *
+     * Returns a null image if the result is too large to be allocated.
+     */
+    QImage render(const SceneSnapshot& snapshot, const QRectF& area,
+        qreal scale, int tileSize = 512);
+}
+
+#endif
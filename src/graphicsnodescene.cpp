@@ -1,12 +1,39 @@
 /* See LICENSE file for copyright and license details. */
 
 #include "graphicsnodescene.hpp"
+#include "graphicsnodeexport_p.h"
 #include <cmath>
+#include <QImage>
 #include <QPainter>
 #include <QGraphicsTextItem>
 #include <algorithm>
 #include <iostream>
 
+// grid cell sizes, in scene units
+static const int   grid_minor = 20;
+static const int   grid_major = 100;
+
+// grid lines closer than this (in device pixels) are not drawn at all
+static const qreal grid_min_spacing = 4.0;
+
+// largest tile edge (in device pixels) worth caching. Past that zoom level
+// there are only a handful of lines on screen and drawing them is cheaper.
+static const int   grid_max_tile = 1024;
+
+// edge of a socket hash cell, in scene units. Roughly the size of a socket,
+// so a cell rarely holds more than a couple of anchors
+static const qreal socket_cell = 32.0;
+
+static inline qint32 socketCellCoord(qreal v)
+{
+	return static_cast<qint32>(std::floor(v / socket_cell));
+}
+
+static inline quint64 socketCellKey(qint32 x, qint32 y)
+{
+	return (quint64(quint32(x)) << 32) | quint64(quint32(y));
+}
+
 // TODO: move to graphicsnodeview. use graphicsnodescene for management
 
 GraphicsNodeScene::GraphicsNodeScene(QObject *parent)
@@ -28,6 +55,90 @@ GraphicsNodeScene::GraphicsNodeScene(QObject *parent)
 }
 
 
+/*
+ * The zoom level is quantized in half octaves, each one of them gets its own
+ * tile. A tile covers exactly one major grid cell, so the brush transform
+ * maps it back onto the scene coordinates without any drift.
+ */
+int GraphicsNodeScene::
+gridBucket(qreal scale)
+{
+	return static_cast<int>(std::floor(std::log2(scale) * 2.0 + 0.5));
+}
+
+
+QBrush GraphicsNodeScene::
+gridBrush(int bucket) const
+{
+	// the tiles are painted over the background, drop them when it changes
+	const QColor background = backgroundBrush().color();
+	if (background != _grid_color) {
+		_grid_brushes.clear();
+		_grid_color = background;
+	}
+
+	const auto it = _grid_brushes.constFind(bucket);
+	if (it != _grid_brushes.constEnd())
+		return *it;
+
+	const qreal bucket_scale = std::pow(2.0, bucket / 2.0);
+	const int   size = std::max(1, static_cast<int>(std::round(grid_major * bucket_scale)));
+	const qreal step = size * static_cast<qreal>(grid_minor) / grid_major;
+
+	QImage tile(size, size, QImage::Format_ARGB32_Premultiplied);
+	tile.fill(background);
+
+	QPainter p(&tile);
+
+	// drop the minor lines when they would be a blur of pixels
+	if (step >= grid_min_spacing) {
+		p.setPen(_pen_light);
+		for (qreal x = step; x < size; x += step) {
+			p.drawLine(QLineF(x, 0, x, size));
+			p.drawLine(QLineF(0, x, size, x));
+		}
+	}
+
+	p.setPen(_pen_dark);
+	p.drawLine(0, 0, size, 0);
+	p.drawLine(0, 0, 0, size);
+	p.end();
+
+	QBrush brush(tile);
+	brush.setTransform(QTransform::fromScale(
+		static_cast<qreal>(grid_major) / size,
+		static_cast<qreal>(grid_major) / size
+	));
+
+	_grid_brushes[bucket] = brush;
+
+	return brush;
+}
+
+
+/*
+ * how the grid is painted at the given scale, shared by drawBackground and
+ * the snapshots so the exports look like the view
+ */
+GraphicsNodeScene::GridMode GraphicsNodeScene::
+gridMode(qreal scale) const
+{
+	// even the major lines would merge, only keep the background
+	if (scale * grid_major < grid_min_spacing)
+		return GridMode::NONE;
+
+	// zoomed in, few lines are visible and the tile would get huge
+	if (std::pow(2.0, gridBucket(scale) / 2.0) * grid_major > grid_max_tile)
+		return GridMode::LINES;
+
+	// the tile is opaque and can only hold a plain color
+	if (backgroundBrush().style() != Qt::SolidPattern)
+		return GridMode::LINES;
+
+	return GridMode::TILE;
+}
+
+
 /*
  * TODO: move the visualization into the graphicsview, and move all the GUI
  * logic into the graphicsnodescene
@@ -35,41 +146,189 @@ GraphicsNodeScene::GraphicsNodeScene(QObject *parent)
 void GraphicsNodeScene::
 drawBackground(QPainter *painter, const QRectF &rect)
 {
-	// call parent method
-	QGraphicsScene::drawBackground(painter, rect);
+	// device pixels per scene unit
+	const QTransform &t = painter->worldTransform();
+	const qreal scale = std::sqrt(t.m11() * t.m11() + t.m12() * t.m12());
+
+	switch (gridMode(scale)) {
+	case GridMode::NONE:
+		QGraphicsScene::drawBackground(painter, rect);
+		break;
+	case GridMode::LINES:
+		QGraphicsScene::drawBackground(painter, rect);
+		drawGridLines(painter, rect);
+		break;
+	case GridMode::TILE:
+		// the tile is opaque, so it also takes care of the background. It
+		// is rendered for the bucket scale, filter it to the exact one
+		painter->save();
+		painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+		painter->fillRect(rect, gridBrush(gridBucket(scale)));
+		painter->restore();
+		break;
+	}
+}
+
+
+void GraphicsNodeScene::
+snapshot(SceneSnapshot &s, qreal scale, const QRectF &rect) const
+{
+	s.m_Background = backgroundBrush();
+	s.m_lGrid.clear();
+
+	switch (gridMode(scale)) {
+	case GridMode::NONE:
+		break;
+	case GridMode::LINES: {
+		QVector<QLine> light, dark;
+		gridLines(rect, light, dark);
 
+		s.m_lGrid << SceneSnapshot::Lines { light, _pen_light }
+		          << SceneSnapshot::Lines { dark , _pen_dark  };
+	}
+		break;
+	case GridMode::TILE:
+		s.m_Background = gridBrush(gridBucket(scale));
+		break;
+	}
+}
+
+
+void GraphicsNodeScene::
+drawGridLines(QPainter *painter, const QRectF &rect)
+{
+	QVector<QLine> lines_light, lines_dark;
+	gridLines(rect, lines_light, lines_dark);
+
+	// draw calls
+	painter->setPen(_pen_light);
+	painter->drawLines(lines_light);
+
+	painter->setPen(_pen_dark);
+	painter->drawLines(lines_dark);
+}
+
+
+void GraphicsNodeScene::
+gridLines(const QRectF &rect, QVector<QLine> &lines_light, QVector<QLine> &lines_dark)
+{
 	// augment the painted with grid
-	const int gridsize = 20;
 	auto left = static_cast<int>(std::floor(rect.left()));
 	auto right = static_cast<int>(std::ceil(rect.right()));
 	auto top = static_cast<int>(std::floor(rect.top()));
 	auto bottom = static_cast<int>(std::ceil(rect.bottom()));
 
 	// compute indices of lines to draw
-	const auto first_left = left - (left % gridsize);
-	const auto first_top = top - (top % gridsize);
-
-	// compute lines to draw and
-	std::vector<QLine> lines_light;
-	std::vector<QLine> lines_dark;
-	for (auto x = first_left; x <= right; x += gridsize) {
-		if (x % 100 != 0)
+	const auto first_left = left - (left % grid_minor);
+	const auto first_top = top - (top % grid_minor);
+
+	// compute lines to draw
+	for (auto x = first_left; x <= right; x += grid_minor) {
+		if (x % grid_major != 0)
 			lines_light.push_back(QLine(x, top, x, bottom));
 		else
 			lines_dark.push_back(QLine(x, top, x, bottom));
 	}
-	for (auto y = first_top; y <= bottom; y += gridsize) {
-		if (y % 100 != 0)
+	for (auto y = first_top; y <= bottom; y += grid_minor) {
+		if (y % grid_major != 0)
 			lines_light.push_back(QLine(left, y, right, y));
 		else
 			lines_dark.push_back(QLine(left, y, right, y));
 	}
+}
 
-	// draw calls
-	painter->setPen(_pen_light);
-	painter->drawLines(lines_light.data(), lines_light.size());
 
-	painter->setPen(_pen_dark);
-	painter->drawLines(lines_dark.data(), lines_dark.size());
+void GraphicsNodeScene::
+updateSocket(GraphicsNodeSocket *socket, const QPointF &anchor)
+{
+	const quint64 key = socketCellKey(
+		socketCellCoord(anchor.x()), socketCellCoord(anchor.y())
+	);
+
+	const auto old = _socket_keys.constFind(socket);
+
+	if (old != _socket_keys.constEnd()) {
+		auto &cell = _socket_cells[*old];
+
+		for (int i = 0; i < cell.size(); i++) {
+			if (cell[i].socket != socket)
+				continue;
+
+			// still in the same cell, only move the anchor
+			if (*old == key) {
+				cell[i].pos = anchor;
+				return;
+			}
+
+			cell.remove(i);
+			break;
+		}
+
+		if (cell.isEmpty())
+			_socket_cells.remove(*old);
+	}
+
+	_socket_cells[key] << SocketAnchor { socket, anchor };
+	_socket_keys[socket] = key;
 }
 
+
+void GraphicsNodeScene::
+removeSocket(GraphicsNodeSocket *socket)
+{
+	const auto old = _socket_keys.find(socket);
+
+	if (old == _socket_keys.end())
+		return;
+
+	auto cell = _socket_cells.find(*old);
+
+	if (cell != _socket_cells.end()) {
+		for (int i = 0; i < cell->size(); i++) {
+			if ((*cell)[i].socket == socket) {
+				cell->remove(i);
+				break;
+			}
+		}
+
+		if (cell->isEmpty())
+			_socket_cells.erase(cell);
+	}
+
+	_socket_keys.erase(old);
+}
+
+
+GraphicsNodeSocket* GraphicsNodeScene::
+nearestSocket(const QPointF &pos, qreal radius,
+	const std::function<bool(GraphicsNodeSocket*)> &accept) const
+{
+	const qint32 left   = socketCellCoord(pos.x() - radius);
+	const qint32 right  = socketCellCoord(pos.x() + radius);
+	const qint32 top    = socketCellCoord(pos.y() - radius);
+	const qint32 bottom = socketCellCoord(pos.y() + radius);
+
+	GraphicsNodeSocket *nearest = nullptr;
+	qreal best = radius * radius;
+
+	for (qint32 x = left; x <= right; x++) {
+		for (qint32 y = top; y <= bottom; y++) {
+			const auto cell = _socket_cells.constFind(socketCellKey(x, y));
+
+			if (cell == _socket_cells.constEnd())
+				continue;
+
+			for (const auto &a : *cell) {
+				const QPointF d = a.pos - pos;
+				const qreal dist = d.x() * d.x() + d.y() * d.y();
+
+				if (dist <= best && ((!accept) || accept(a.socket))) {
+					best = dist;
+					nearest = a.socket;
+				}
+			}
+		}
+	}
+
+	return nearest;
+}
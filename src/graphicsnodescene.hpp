@@ -3,9 +3,17 @@
 #ifndef __GRAPHICSNODESCENE_HPP__7F9E4C1E_8F4E_4BD2_BDF7_3D4ECEC206B5
 #define __GRAPHICSNODESCENE_HPP__7F9E4C1E_8F4E_4BD2_BDF7_3D4ECEC206B5
 
+#include <QLine>
 #include <QRectF>
+#include <QHash>
+#include <QVector>
+#include <QBrush>
 #include <QGraphicsScene>
 
+#include <functional>
+
+class GraphicsNodeSocket;
+struct SceneSnapshot;
 
 class GraphicsNodeScene : public QGraphicsScene
 {
@@ -14,10 +22,67 @@ class GraphicsNodeScene : public QGraphicsScene
 public:
 	GraphicsNodeScene(QObject *parent);
 
+	/**
+	 * brush textured with the grid over the backgroundBrush() color,
+	 * rendered for the given zoom bucket. The texture is a QImage, so the
+	 * brush can be handed to other threads
+	 */
+	QBrush gridBrush(int bucket) const;
+
+	static int gridBucket(qreal scale);
+
+	/**
+	 * background of an export at the given scale, painted like
+	 * drawBackground would. Past the largest tile, the grid lines of rect
+	 * are copied instead of the brush
+	 */
+	void snapshot(SceneSnapshot &s, qreal scale, const QRectF &rect) const;
+
+	/**
+	 * spatial hash of the socket anchors, in scene coordinates. The nodes
+	 * keep it up to date when they move or change their geometry, so the
+	 * view never has to query the whole item tree to find a socket.
+	 */
+	void updateSocket(GraphicsNodeSocket *socket, const QPointF &anchor);
+	void removeSocket(GraphicsNodeSocket *socket);
+
+	/**
+	 * nearest socket whose anchor is within radius (in scene units) of pos
+	 * and for which accept (if set) returns true
+	 */
+	GraphicsNodeSocket* nearestSocket(const QPointF &pos, qreal radius,
+		const std::function<bool(GraphicsNodeSocket*)> &accept = {}) const;
+
 protected:
 	virtual void drawBackground(QPainter *painter, const QRectF &rect) override;
 
 private:
+	enum class GridMode {
+		NONE,  // the lines would merge, background only
+		TILE,  // cached tile brush
+		LINES, // plain lines, the tile would be too large
+	};
+
+	GridMode gridMode(qreal scale) const;
+	static void gridLines(const QRectF &rect, QVector<QLine> &lines_light,
+		QVector<QLine> &lines_dark);
+
+	void drawGridLines(QPainter *painter, const QRectF &rect);
+
+	// one tile per zoom bucket, created on first use
+	mutable QHash<int, QBrush> _grid_brushes;
+
+	// background color of the cached tiles
+	mutable QColor _grid_color;
+
+	struct SocketAnchor {
+		GraphicsNodeSocket *socket;
+		QPointF pos;
+	};
+
+	QHash<quint64, QVector<SocketAnchor>> _socket_cells;
+	QHash<GraphicsNodeSocket*, quint64> _socket_keys;
+
 	QColor _color_background;
 	QColor _color_light;
 	QColor _color_dark;
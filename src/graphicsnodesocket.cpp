@@ -16,6 +16,8 @@
 #include "graphicsnode.hpp"
 
 #include "graphicsnodesocket_p.h"
+#include "graphicsnode_p.h"
+#include "graphicsnodeexport_p.h"
 
 #include "qnodeeditorsocketmodel.h"
 
@@ -26,6 +28,14 @@
 
 #include "graphicsbezieredge_p.h"
 
+// Necessary for some compilers...
+constexpr const qreal GraphicsNodeSocketPrivate::_pen_width;
+constexpr const qreal GraphicsNodeSocketPrivate::_circle_radius;
+constexpr const qreal GraphicsNodeSocketPrivate::_text_offset;
+constexpr const qreal GraphicsNodeSocketPrivate::_min_width;
+constexpr const qreal GraphicsNodeSocketPrivate::_min_height;
+constexpr const qreal GraphicsNodeSocketPrivate::_nest_indent;
+
 GraphicsNodeSocket::
 GraphicsNodeSocket(const QModelIndex& index, SocketType socket_type, GraphicsNode *parent)
 : QObject(), d_ptr(new GraphicsNodeSocketPrivate(this))
@@ -39,9 +49,115 @@ GraphicsNodeSocket(const QModelIndex& index, SocketType socket_type, GraphicsNod
 
     d_ptr->_pen_circle.setWidth(0);
 
-    d_ptr->m_pGraphicsItem = new SocketGraphicsItem(parent->graphicsItem(), d_ptr);
+    d_ptr->m_pNode = parent;
+
+    // The rows nested below other sockets are indented. A socket moved to
+    // another parent is created again, so the depth never changes
+    for (auto p = index.parent().parent(); p.isValid(); p = p.parent())
+        d_ptr->m_Indent += d_ptr->_nest_indent;
+
+    d_ptr->updateStyle();
+
+    // Otherwise it will be created when the node is realized
+    if (auto item = parent->graphicsItem())
+        d_ptr->realize(item, nullptr);
+}
+
+void GraphicsNodeSocketPrivate::
+realize(QGraphicsItem* parent, NodeItemPool* pool)
+{
+    if (m_pGraphicsItem)
+        return;
+
+    if (pool && !pool->m_lSockets.isEmpty()) {
+        m_pGraphicsItem = pool->m_lSockets.takeLast();
+        m_pGraphicsItem->d_ptr = this;
+        m_pGraphicsItem->setParentItem(parent);
+    }
+    else {
+        m_pGraphicsItem = new SocketGraphicsItem(parent, this);
+        m_pGraphicsItem->setAcceptDrops(true);
+    }
+
+    m_pGraphicsItem->setPos(m_Pos);
+    m_pGraphicsItem->setOpacity(m_Opacity);
+}
+
+void GraphicsNodeSocketPrivate::
+unrealize(NodeItemPool* pool)
+{
+    if (!m_pGraphicsItem)
+        return;
+
+    if (pool) {
+        m_pGraphicsItem->setParentItem(nullptr);
+        m_pGraphicsItem->d_ptr = nullptr;
+        pool->m_lSockets << m_pGraphicsItem;
+    }
+    else
+        delete m_pGraphicsItem;
+
+    m_pGraphicsItem = nullptr;
+}
+
+void GraphicsNodeSocket::
+updateStyle()
+{
+    d_ptr->updateStyle();
+}
+
+void GraphicsNodeSocketPrivate::
+updateStyle()
+{
+    const auto bg = m_PersistentIndex.data(Qt::BackgroundRole);
+
+    m_Brush = bg.canConvert<QBrush>() ? qvariant_cast<QBrush>(bg) : _brush_circle;
+
+    auto fg = m_PersistentIndex.data(Qt::ForegroundRole);
+
+    // Same color as the node
+    if (!fg.isValid())
+        fg = m_pNode->index().data(Qt::ForegroundRole);
+
+    if (fg.canConvert<QColor>())
+        m_TextPen = QPen(qvariant_cast<QColor>(fg));
+    else if (fg.canConvert<QPen>())
+        m_TextPen = qvariant_cast<QPen>(fg);
+    else
+        m_TextPen = _pen_text;
+
+    m_Text = m_PersistentIndex.data().toString();
+
+    // The size only depends on the label, so painting never reads the model
+    const QSizeF size = sizeForText(m_Text, m_Indent);
+
+    if (size != m_Size) {
+        if (m_pGraphicsItem)
+            m_pGraphicsItem->prepareGeometryChange();
+
+        m_Size = size;
+    }
 
-    d_ptr->m_pGraphicsItem->setAcceptDrops(true);
+    if (m_pGraphicsItem)
+        m_pGraphicsItem->update();
+}
+
+void GraphicsNodeSocketPrivate::
+setPos(const QPointF& pos)
+{
+    m_Pos = pos;
+
+    if (m_pGraphicsItem)
+        m_pGraphicsItem->setPos(pos);
+}
+
+void GraphicsNodeSocketPrivate::
+setOpacity(qreal opacity)
+{
+    m_Opacity = opacity;
+
+    if (m_pGraphicsItem)
+        m_pGraphicsItem->setOpacity(opacity);
 }
 
 QGraphicsItem *GraphicsNodeSocket::
@@ -92,23 +208,30 @@ boundingRect() const
 }
 
 
-QSizeF GraphicsNodeSocket::
-minimalSize() const {
+QSizeF GraphicsNodeSocketPrivate::
+sizeForText(const QString& label, qreal indent)
+{
     // Assumes the theme doesn't change
     static QFontMetrics fm({});
     static const qreal  text_height = static_cast<qreal>(fm.height());
-    const int           text_width  = fm.width(text());
+    const int           text_width  = fm.width(label);
 
     return {
         std::max(
-            d_ptr->_min_width,
-            d_ptr->_circle_radius*2 + d_ptr->_text_offset + text_width + d_ptr->_pen_width
+            _min_width,
+            _circle_radius*2 + _text_offset + indent + text_width + _pen_width
         ),
-        std::max(d_ptr->_min_height, text_height + d_ptr->_pen_width)
+        std::max(_min_height, text_height + _pen_width)
     };
 }
 
 
+QSizeF GraphicsNodeSocket::
+minimalSize() const {
+    return d_ptr->m_Size;
+}
+
+
 QSizeF GraphicsNodeSocket::
 size() const
 {
@@ -116,8 +239,41 @@ size() const
 }
 
 
+void GraphicsNodeSocket::
+snapshot(SceneSnapshot& s) const
+{
+    // The label is always drawn within the node
+    const qreal m = d_ptr->_circle_radius + d_ptr->_pen_width;
+
+    s.m_lSockets << SceneSnapshot::Socket {
+        d_ptr->m_pNode->rect().adjusted(-m, -m, m, m),
+        d_ptr->sceneAnchorPos(),
+        d_ptr->_socket_type,
+        d_ptr->m_Brush,
+        d_ptr->m_TextPen,
+        d_ptr->m_Text,
+        d_ptr->m_Indent,
+        d_ptr->m_Opacity
+    };
+}
+
+
+void GraphicsNodeSocketPrivate::
+paintSocket(QPainter *painter, GraphicsNodeSocket::SocketType type,
+    const QPen& circle, const QBrush& brush, const QPen& text, const QString& label,
+    qreal indent)
+{
+    painter->setPen(circle);
+    painter->setBrush(brush);
+
+    painter->drawEllipse(QRectF(-_circle_radius, -_circle_radius, _circle_radius*2, _circle_radius*2));
+    drawAlignedText(painter, type, text, label, indent);
+}
+
+
 void GraphicsNodeSocketPrivate::
-drawAlignedText(QPainter *painter)
+drawAlignedText(QPainter *painter, GraphicsNodeSocket::SocketType type,
+    const QPen& text, const QString& label, qreal indent)
 {
     int flags = Qt::AlignVCenter;
 
@@ -125,10 +281,10 @@ drawAlignedText(QPainter *painter)
 
     QPointF corner;
 
-    switch(_socket_type) {
+    switch(type) {
         case GraphicsNodeSocket::SocketType::SINK:
             corner = {
-                _circle_radius + _text_offset,
+                _circle_radius + _text_offset + indent,
                 -s
             };
             corner.ry() += s/2.0;
@@ -136,7 +292,7 @@ drawAlignedText(QPainter *painter)
             break;
         case GraphicsNodeSocket::SocketType::SOURCE:
             corner = {
-                -_circle_radius - _text_offset,
+                -_circle_radius - _text_offset - indent,
                 -s
             };
             corner.ry() += s/2.0; //TODO find out why it was done this way
@@ -147,41 +303,26 @@ drawAlignedText(QPainter *painter)
 
     const QRectF rect(corner, QSizeF(s, s));
 
-    auto fg = m_PersistentIndex.data(Qt::ForegroundRole);
-
-    // Same color as the node
-    if (!fg.isValid())
-        fg = m_PersistentIndex.parent().data(Qt::ForegroundRole);
-
-    if (fg.canConvert<QPen>())
-        painter->setPen(qvariant_cast<QPen>(fg));
-    if (fg.canConvert<QColor>())
-        painter->setPen(qvariant_cast<QColor>(fg));
-    else
-        painter->setPen(_pen_text);
-
-    painter->drawText(rect, flags, m_PersistentIndex.data().toString(), 0);
+    painter->setPen(text);
+    painter->drawText(rect, flags, label, 0);
 }
 
 
 QPointF GraphicsNodeSocketPrivate::
 sceneAnchorPos() const
 {
-    return m_pGraphicsItem->mapToScene(0,0);
+    // Also valid when the node isn't realized
+    return m_pNode->rect().topLeft() + m_Pos;
 }
 
 
 void SocketGraphicsItem::
 paint(QPainter *painter, const QStyleOptionGraphicsItem * /*option*/, QWidget * /*widget*/)
 {
-    painter->setPen(d_ptr->_pen_circle);
-
-    const auto bg = d_ptr->m_PersistentIndex.data(Qt::BackgroundRole);
-
-    painter->setBrush(bg.canConvert<QBrush>() ? qvariant_cast<QBrush>(bg) : d_ptr->_brush_circle);
-
-    painter->drawEllipse(-d_ptr->_circle_radius, -d_ptr->_circle_radius, d_ptr->_circle_radius*2, d_ptr->_circle_radius*2);
-    d_ptr->drawAlignedText(painter);
+    GraphicsNodeSocketPrivate::paintSocket(painter, d_ptr->_socket_type,
+        d_ptr->_pen_circle, d_ptr->m_Brush, d_ptr->m_TextPen, d_ptr->m_Text,
+        d_ptr->m_Indent
+    );
 
     // debug painting the bounding box
 #if 0
@@ -258,7 +399,8 @@ bool GraphicsNodeSocket::isEnabled() const
 QString GraphicsNodeSocket::
 text() const
 {
-    return d_ptr->m_PersistentIndex.data().toString();
+    // Refreshed by updateStyle()
+    return d_ptr->m_Text;
 }
 
 void GraphicsNodeSocket::
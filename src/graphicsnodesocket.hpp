@@ -17,6 +17,7 @@ class GraphicsNode;
 class QNodeEditorSocketModel;
 
 class GraphicsNodeSocketPrivate;
+struct SceneSnapshot;
 
 /**
 * visual representation of a socket. the visual representation consists of a
@@ -31,6 +32,9 @@ class GraphicsNodeSocket : public QObject
     friend class GraphicsDirectedEdgePrivate; // could be removed once the model is ready
     friend class GraphicsNodeView; //for the view helpers, could be removed
     friend class SocketWrapper; // For the constructor
+    friend class QNodeEditorEdgeModel; // for the anchor positions
+    friend class QNodeEditorSocketModel; // for the anchor positions
+    friend class QNodeEditorSocketModelPrivate; // to refresh the style
 public:
     /*
     * the socket comes in two flavors: either as sink or as source for a
@@ -70,6 +74,9 @@ Q_SIGNALS:
 private:
     explicit GraphicsNodeSocket(const QModelIndex& index, SocketType socket_type, GraphicsNode *parent);
 
+    void updateStyle();
+    void snapshot(SceneSnapshot& s) const;
+
     GraphicsNodeSocketPrivate* d_ptr;
     Q_DECLARE_PRIVATE(GraphicsNodeSocket)
 };
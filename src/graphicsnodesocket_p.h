@@ -10,6 +10,8 @@
 #define PEN_COLOR_TEXT        QColor("#FFFFFFFF")
 
 class SocketGraphicsItem;
+class NodeItemPool;
+struct SceneSnapshot;
 
 class GraphicsNodeSocketPrivate
 {
@@ -34,23 +36,49 @@ public:
     QPersistentModelIndex m_PersistentIndex;
     QPersistentModelIndex m_EdgeIndex;
 
-    const qreal _pen_width = 1.0;
-    const qreal _circle_radius = 6.0;
-    const qreal _text_offset = 3.0;
+    constexpr static const qreal _pen_width = 1.0;
+    constexpr static const qreal _circle_radius = 6.0;
+    constexpr static const qreal _text_offset = 3.0;
 
-    const qreal _min_width = 30;
-    const qreal _min_height = 12.0;
+    constexpr static const qreal _min_width = 30;
+    constexpr static const qreal _min_height = 12.0;
 
-    SocketGraphicsItem* m_pGraphicsItem;
+    // Per level of the nested sockets
+    constexpr static const qreal _nest_indent = 10.0;
+
+    SocketGraphicsItem* m_pGraphicsItem {nullptr};
+
+    // The record, kept when the node is not realized
+    GraphicsNode* m_pNode   {nullptr};
+    QPointF       m_Pos     {0, 0};
+    qreal         m_Opacity {1.0};
+    qreal         m_Indent  {0.0};
+
+    // Resolved style, refreshed by the model on dataChanged
+    QBrush  m_Brush;
+    QPen    m_TextPen {PEN_COLOR_TEXT};
+    QString m_Text;
+    QSizeF  m_Size;
 
     // Helper
-    void drawAlignedText(QPainter *painter);
+    static void paintSocket(QPainter *painter, GraphicsNodeSocket::SocketType type,
+        const QPen& circle, const QBrush& brush, const QPen& text, const QString& label,
+        qreal indent);
+    static void drawAlignedText(QPainter *painter, GraphicsNodeSocket::SocketType type,
+        const QPen& text, const QString& label, qreal indent);
+    static QSizeF sizeForText(const QString& label, qreal indent);
+    void setPos(const QPointF& pos);
+    void setOpacity(qreal opacity);
+    void updateStyle();
+    void realize(QGraphicsItem* parent, NodeItemPool* pool);
+    void unrealize(NodeItemPool* pool);
 
     GraphicsNodeSocket* q_ptr;
 };
 
 class SocketGraphicsItem final : public QGraphicsItem
 {
+    friend class GraphicsNodeSocketPrivate; // to call prepareGeometryChange
 public:
     SocketGraphicsItem(QGraphicsItem* parent, GraphicsNodeSocketPrivate* d) :
         QGraphicsItem(parent), d_ptr(d) {}
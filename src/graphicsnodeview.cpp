@@ -8,8 +8,10 @@
 #include <QGraphicsDropShadowEffect>
 #include <QResizeEvent>
 #include <QGraphicsItem>
+#include <QPainter>
 
 #include "graphicsnode.hpp"
+#include "graphicsnodescene.hpp"
 #include "graphicsnodesocket.hpp"
 #include "graphicsnodedefs.hpp"
 #include "graphicsbezieredge.hpp"
@@ -20,6 +22,104 @@
 
 #include "qnodeeditorsocketmodel.h"
 
+
+/**
+ * Draw all the nodes and edges at once from packed arrays, for when they are
+ * too small for their own items to be of any use.
+ */
+class OverviewGraphicsItem final : public QGraphicsItem
+{
+public:
+	explicit OverviewGraphicsItem(QNodeEditorSocketModel *model)
+	: _model(model)
+	{
+		setAcceptedMouseButtons(Qt::NoButton);
+		setZValue(-1);
+
+		_node_pen.setWidth(0);
+		_edge_pen.setWidth(0);
+	}
+
+	virtual QRectF boundingRect() const override;
+	virtual void paint(QPainter *painter,
+			const QStyleOptionGraphicsItem *option,
+			QWidget *widget = 0) override;
+
+	// the geometry is fetched again before the next paint
+	void invalidate();
+
+private:
+	void rebuild() const;
+
+	QNodeEditorSocketModel *_model;
+
+	QPen   _node_pen   {QColor("#7F000000")};
+	QBrush _node_brush {QColor("#E31a1a1a")};
+	QPen   _edge_pen   {QColor("#FFFF7700")};
+
+	mutable bool _dirty = true;
+	mutable QRectF _bounds;
+	mutable QVector<QRectF> _nodes;
+	mutable QVector<QLineF> _edges;
+};
+
+
+void OverviewGraphicsItem::
+invalidate()
+{
+	prepareGeometryChange();
+	_dirty = true;
+}
+
+
+void OverviewGraphicsItem::
+rebuild() const
+{
+	_model->overviewGeometry(_nodes, _edges);
+
+	const QVector<QRectF> &nodes = _nodes;
+	const QVector<QLineF> &edges = _edges;
+
+	QRectF r;
+
+	for (const auto &n : nodes)
+		r |= n;
+
+	for (const auto &e : edges)
+		r |= QRectF(e.p1(), e.p2()).normalized();
+
+	_bounds = r;
+	_dirty = false;
+}
+
+
+QRectF OverviewGraphicsItem::
+boundingRect() const
+{
+	if (_dirty)
+		rebuild();
+
+	return _bounds;
+}
+
+
+void OverviewGraphicsItem::
+paint(QPainter *painter, const QStyleOptionGraphicsItem * /*option*/, QWidget * /*widget*/)
+{
+	if (_dirty)
+		rebuild();
+
+	painter->setRenderHint(QPainter::Antialiasing, false);
+
+	painter->setPen(_edge_pen);
+	painter->drawLines(_edges);
+
+	painter->setPen(_node_pen);
+	painter->setBrush(_node_brush);
+	painter->drawRects(_nodes);
+}
+
+
 GraphicsNodeView::GraphicsNodeView(QWidget *parent)
 : GraphicsNodeView(nullptr, parent)
 { }
@@ -38,6 +138,14 @@ GraphicsNodeView::GraphicsNodeView(QGraphicsScene *scene, QWidget *parent)
 	setResizeAnchor(NoAnchor);
 	setTransformationAnchor(AnchorUnderMouse);
 	// setDragMode(QGraphicsView::RubberBandDrag);
+
+	_overview_timer.setSingleShot(true);
+	_overview_timer.setInterval(0);
+
+	connect(&_overview_timer, &QTimer::timeout, this, [this]() {
+		if (isOverviewActive())
+			_overview->invalidate();
+	});
 }
 
 
@@ -52,6 +160,137 @@ resizeEvent(QResizeEvent *event)
 		first_resize = false;
 	}
 	QGraphicsView::resizeEvent(event);
+	update_realized_area();
+}
+
+
+void GraphicsNodeView::
+scrollContentsBy(int dx, int dy)
+{
+	QGraphicsView::scrollContentsBy(dx, dy);
+	update_realized_area();
+
+	// setTransform() and scale() move the scrollbars too
+	update_overview();
+}
+
+
+void GraphicsNodeView::
+update_realized_area()
+{
+	if (!m_pModel)
+		return;
+
+	const QRectF visible = mapToScene(viewport()->rect()).boundingRect();
+	const qreal margin = scene_radius(_realize_margin);
+
+	m_pModel->setRealizedArea(
+		visible.adjusted(-margin, -margin, margin, margin)
+	);
+}
+
+
+bool GraphicsNodeView::
+isVirtualized() const
+{
+	return m_pModel ? m_pModel->isVirtualized() : true;
+}
+
+
+void GraphicsNodeView::
+setVirtualized(bool value)
+{
+	if (m_pModel)
+		m_pModel->setVirtualized(value);
+}
+
+
+bool GraphicsNodeView::
+hasOrthogonalEdges() const
+{
+	return m_pModel && m_pModel->edgeStyle()
+		== QNodeEditorSocketModel::EdgeStyle::ORTHOGONAL;
+}
+
+
+void GraphicsNodeView::
+setOrthogonalEdges(bool value)
+{
+	if (m_pModel)
+		m_pModel->setEdgeStyle(value ?
+			QNodeEditorSocketModel::EdgeStyle::ORTHOGONAL :
+			QNodeEditorSocketModel::EdgeStyle::BEZIER
+		);
+}
+
+
+qreal GraphicsNodeView::
+overviewThreshold() const
+{
+	return _overview_threshold;
+}
+
+
+void GraphicsNodeView::
+setOverviewThreshold(qreal scale)
+{
+	_overview_threshold = scale;
+	update_overview();
+}
+
+
+bool GraphicsNodeView::
+isOverviewActive() const
+{
+	return _overview && _overview->isVisible();
+}
+
+
+void GraphicsNodeView::
+update_overview()
+{
+	if (!(m_pModel && scene()))
+		return;
+
+	const bool active = transform().m11() < _overview_threshold;
+
+	if (active == isOverviewActive())
+		return;
+
+	if (!_overview) {
+		_overview = new OverviewGraphicsItem(m_pModel);
+		_overview->setVisible(false);
+		scene()->addItem(_overview);
+
+		// only the cache is invalidated, once per event loop iteration.
+		// It is rebuilt when painted
+		const auto invalidate = [this]() {
+			if (isOverviewActive())
+				_overview_timer.start();
+		};
+
+		// the style changes don't move anything
+		const auto geometryChanged = [invalidate](const QModelIndex&,
+			const QModelIndex&, const QVector<int> &roles) {
+			if (roles.isEmpty() || roles.contains(Qt::SizeHintRole))
+				invalidate();
+		};
+
+		connect(m_pModel, &QAbstractItemModel::dataChanged, this, geometryChanged);
+		connect(m_pModel, &QAbstractItemModel::rowsInserted, this, invalidate);
+		connect(m_pModel, &QAbstractItemModel::rowsRemoved, this, invalidate);
+		connect(m_pModel->edgeModel(), &QAbstractItemModel::dataChanged, this, invalidate);
+	}
+
+	// the geometry isn't tracked while hidden
+	if (active)
+		_overview->invalidate();
+
+	m_pModel->setDetailedItemsVisible(!active);
+	_overview->setVisible(active);
+
+	if (!active)
+		update_realized_area();
 }
 
 
@@ -69,6 +308,8 @@ wheelEvent(QWheelEvent *event) {
 			// zoom out
 			scale(1.0 / scaleFactor, 1.0 / scaleFactor);
 		}
+		update_realized_area();
+		update_overview();
 		event->accept();
 	}
 	else {
@@ -111,10 +352,9 @@ void GraphicsNodeView::
 leftMouseButtonRelease(QMouseEvent *event)
 {
 	if (_drag_event) {
-		auto sock = socket_at(event->pos());
+		auto sock = snap_target(event->pos());
 
-
-		if (!sock || !can_accept_edge(sock)) {
+		if (!sock) {
 			_drag_event->e->setSource({});
 			_drag_event->e->setSink({});
 		} else {
@@ -170,36 +410,38 @@ mouseMoveEvent(QMouseEvent *event)
 	// temporary edge already set
 	if (_drag_event && (event->buttons() & Qt::LeftButton)) {
 
-		// set start/stop (ignored if the sockets are set)
-		_drag_event->e->d_ptr->setStart(mapToScene(event->pos()));
-		_drag_event->e->d_ptr->setStop (mapToScene(event->pos()));
+		// update visual feedback, and snap the loose end of the edge to
+		// the closest socket it can be dropped on
+		QPointF scenePos = mapToScene(event->pos());
 
-		// update visual feedback
-		auto sock = socket_at(event->pos());
-		if (!sock) {
-			viewport()->setCursor(Qt::ClosedHandCursor);
+		if (auto sock = snap_target(event->pos())) {
+			viewport()->setCursor(Qt::DragMoveCursor);
+			scenePos = sock->d_ptr->sceneAnchorPos();
+		}
+		else if (socket_at(event->pos(), _snap_radius)) {
+			viewport()->setCursor(Qt::ForbiddenCursor);
 		}
 		else {
-			if (!can_accept_edge(sock))
-				viewport()->setCursor(Qt::ForbiddenCursor);
-			else {
-				viewport()->setCursor(Qt::DragMoveCursor);
-			}
+			viewport()->setCursor(Qt::ClosedHandCursor);
 		}
+
+		// set start/stop (ignored if the sockets are set)
+		_drag_event->e->d_ptr->setStart(scenePos);
+		_drag_event->e->d_ptr->setStop (scenePos);
 	}
 	else if (_resize_event && (event->buttons() & Qt::LeftButton)) {
 		QPointF size = mapToScene(event->pos())
-            - _resize_event->node->graphicsItem()->mapToScene(0,0);
+            - _resize_event->node->rect().topLeft();
 		_resize_event->node->setSize(size);
 	}
 	else {
 		// no button is pressed, so indicate what the user can do with
 		// the item by changing the cursor
 		if (event->buttons() == 0) {
-			auto sock = socket_at(event->pos());
+			auto sock = socket_at(event->pos(), _hover_radius);
 			if (sock) {
 				QPointF scenePos = mapToScene(event->pos());
-				QPointF itemPos = sock->graphicsItem()->mapFromScene(scenePos);
+				QPointF itemPos = scenePos - sock->d_ptr->sceneAnchorPos();
 				if (sock->d_ptr->isInSocketCircle(itemPos))
 					viewport()->setCursor(Qt::OpenHandCursor);
 				else
@@ -329,9 +571,23 @@ can_accept_edge(GraphicsNodeSocket *sock)
 }
 
 
+qreal GraphicsNodeView::
+scene_radius(qreal pixels) const
+{
+	const qreal scale = transform().m11();
+
+	return scale > 0 ? pixels / scale : pixels;
+}
+
+
 GraphicsNodeSocket* GraphicsNodeView::
-socket_at(QPoint pos)
+socket_at(QPoint pos, qreal radius)
 {
+	// the scene keeps a spatial hash of the socket anchors, so there is no
+	// need to step through all the items under the cursor
+	if (auto s = qobject_cast<GraphicsNodeScene*>(scene()))
+		return s->nearestSocket(mapToScene(pos), scene_radius(radius));
+
 	// figure out if we are above another socket. this requires
 	// stepping through all items that we can actually see, and
 	// taking the topmost one
@@ -352,3 +608,18 @@ socket_at(QPoint pos)
 		return nullptr;
     }
 }
+
+
+GraphicsNodeSocket* GraphicsNodeView::
+snap_target(QPoint pos)
+{
+	if (auto s = qobject_cast<GraphicsNodeScene*>(scene())) {
+		return s->nearestSocket(mapToScene(pos), scene_radius(_snap_radius),
+			[this](GraphicsNodeSocket *sock) { return can_accept_edge(sock); }
+		);
+	}
+
+	auto sock = socket_at(pos, _snap_radius);
+
+	return can_accept_edge(sock) ? sock : nullptr;
+}
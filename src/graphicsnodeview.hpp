@@ -5,6 +5,7 @@
 
 #include <QGraphicsView>
 #include <QPoint>
+#include <QTimer>
 
 class QMimeData;
 class QResizeEvent;
@@ -15,6 +16,7 @@ class GraphicsNodeSocket;
 //HACK this is totally *not* fine to put the architecture on its head
 class QNodeEditorEdgeModel; 
 class QNodeEditorSocketModel;
+class OverviewGraphicsItem;
 
 struct EdgeDragEvent
 {
@@ -46,12 +48,27 @@ public:
 	explicit GraphicsNodeView(QWidget *parent = nullptr);
 	GraphicsNodeView(QGraphicsScene *scene, QWidget *parent = nullptr);
 
+	// only create the node graphics items around the visible area
+	bool isVirtualized() const;
+	void setVirtualized(bool value);
+
+	// below this zoom level, all nodes and edges are drawn by a single
+	// aggregated item instead of their own graphics items
+	qreal overviewThreshold() const;
+	void setOverviewThreshold(qreal scale);
+	bool isOverviewActive() const;
+
+	// route the edges around the nodes instead of drawing bezier curves
+	bool hasOrthogonalEdges() const;
+	void setOrthogonalEdges(bool value);
+
 protected:
 	virtual void wheelEvent(QWheelEvent *event);
 	virtual void mouseMoveEvent(QMouseEvent *event);
 	virtual void mousePressEvent(QMouseEvent *event);
 	virtual void mouseReleaseEvent(QMouseEvent *event);
 	virtual void resizeEvent(QResizeEvent *event);
+	virtual void scrollContentsBy(int dx, int dy) override;
 
     QNodeEditorSocketModel* m_pModel {nullptr}; //HACK evil workaround until the QAbstractItemView is added
 
@@ -63,12 +80,33 @@ private:
 	void leftMouseButtonRelease(QMouseEvent *event);
 
 	bool can_accept_edge(GraphicsNodeSocket *sock);
-	GraphicsNodeSocket* socket_at(QPoint pos);
+
+	// radius (in pixels) around pos in which sockets are looked for
+	GraphicsNodeSocket* socket_at(QPoint pos, qreal radius);
+
+	// nearest socket the edge being dragged can be dropped on
+	GraphicsNodeSocket* snap_target(QPoint pos);
+
+	qreal scene_radius(qreal pixels) const;
+
+	void update_realized_area();
+	void update_overview();
 
 private:
 	EdgeDragEvent *_drag_event = nullptr;
 	NodeResizeEvent *_resize_event = nullptr;
 
+	// in pixels, the hover one matches the socket circle
+	const qreal _hover_radius = 9.0;
+	const qreal _snap_radius = 20.0;
+	const qreal _realize_margin = 256.0;
+
+	qreal _overview_threshold = 0.25;
+	OverviewGraphicsItem *_overview = nullptr;
+
+	// coalesce the model changes into a single overview rebuild
+	QTimer _overview_timer;
+
 };
 
 #endif /* __GRAPHICSNODEVIEW_HPP__59C6610F_3283_42A1_9102_38A7065DB718 */
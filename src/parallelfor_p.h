@@ -0,0 +1,48 @@
+#ifndef PARALLEL_FOR_P_H
+#define PARALLEL_FOR_P_H
+
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThreadPool>
+
+/**
+ * Call f(i) for i in [0, count) on the global thread pool and wait for all
+ * of them to finish. f has to be reentrant.
+ */
+template<typename F>
+void parallelFor(int count, const F& f)
+{
+    class Task final : public QRunnable
+    {
+    public:
+        Task(const F& f, int i, QSemaphore& done) : m_F(f), m_I(i), m_Done(done) {}
+
+        virtual void run() override {
+            m_F(m_I);
+            m_Done.release();
+        }
+
+    private:
+        const F&    m_F;
+        const int   m_I;
+        QSemaphore& m_Done;
+    };
+
+    if (count <= 0)
+        return;
+
+    // Not worth a context switch
+    if (count == 1) {
+        f(0);
+        return;
+    }
+
+    QSemaphore done;
+
+    for (int i = 0; i < count; i++)
+        QThreadPool::globalInstance()->start(new Task(f, i, done));
+
+    done.acquire(count);
+}
+
+#endif
@@ -0,0 +1,692 @@
+#include "qforcenodelayout.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QPointF>
+#include <QtCore/QRectF>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
+#include <QtCore/QVarLengthArray>
+#include <QtCore/QVector>
+
+#include <algorithm>
+#include <cmath>
+
+#include "graphicsnode.hpp"
+#include "qnodeeditorsocketmodel.h"
+#include "parallelfor_p.h"
+
+#if QT_VERSION < 0x050700
+//Q_FOREACH is deprecated and Qt CoW containers are detached on C++11 for loops
+template<typename T>
+const T& qAsConst(const T& v)
+{
+    return const_cast<const T&>(v);
+}
+#endif
+
+// Number of nodes per parallel task
+static const int force_chunk = 512;
+
+// Stop when no node moves more than this, in scene units
+static const qreal force_epsilon = 0.5;
+
+// Below this cell size, the points are considered coincident
+static const qreal force_min_cell = 1.0;
+
+/**
+ * Flattened Barnes-Hut quadtree. The 4 children of a cell are contiguous.
+ */
+class ForceQuadTree final
+{
+public:
+    explicit ForceQuadTree(const QVector<QPointF>& positions);
+
+    /// The repulsion applied on body `self` by all others
+    QPointF repulsion(int self, qreal k2, qreal theta) const;
+
+private:
+    struct Cell {
+        Cell(qreal x = 0, qreal y = 0, qreal half = 0) :
+            m_X(x), m_Y(y), m_Half(half) {}
+
+        qreal m_X, m_Y, m_Half;
+        qreal m_Mass  {0};
+        qreal m_SumX  {0};
+        qreal m_SumY  {0};
+        int   m_Child {-1}; // first child, -1 for leaves
+        int   m_Body  {-1}; // the body of a leaf with a mass of 1
+    };
+
+    const QVector<QPointF>& m_lPositions;
+    QVector<Cell> m_lCells;
+
+    int quadrant(int cell, const QPointF& p) const;
+    void insert(int body);
+};
+
+struct ForceSimulation final
+{
+    QVector<QPointF> m_lPositions; // centers
+    QVector<int>     m_lAdjStart;  // CSR adjacency, undirected
+    QVector<int>     m_lAdj;
+    QVector<bool>    m_lMovable;
+    qreal            m_K;
+    qreal            m_Theta;
+    int              m_MaxIterations;
+};
+
+class QForceNodeLayoutPrivate final
+{
+public:
+    QNodeEditorSocketModel* m_pModel;
+
+    qreal m_SpringLength  {200.0};
+    qreal m_Theta         {0.8  };
+    int   m_MaxIterations {500  };
+    int   m_FrameRate     {30   };
+    bool  m_IsIncremental {false};
+    bool  m_IsRunning     {false};
+
+    // Number of simulations with a pending slotFinished
+    int m_Queued {0};
+
+    QThreadPool m_Pool;
+    QTimer      m_FrameTimer;
+    QAtomicInt  m_Stop {0};
+
+    // The nodes and sizes when the simulation started, GUI thread only
+    QVector<GraphicsNode*> m_lNodes;
+    QVector<QSizeF>        m_lSizes;
+    QVector<bool>          m_lMovable;
+
+    // Incremental mode
+    QList<QPersistentModelIndex> m_lInserted;
+
+    // Published by the worker
+    QMutex           m_Mutex;
+    QVector<QPointF> m_lFrame;
+    bool             m_HasFrame {false};
+
+    // Helpers
+    void launch(const QVector<bool>& movable, const QVector<int>& seeds, bool place);
+    void applyFrame(const QVector<QPointF>& centers);
+    void publish(const QVector<QPointF>& centers);
+    QVector<bool> neighbourhood(const QModelIndexList& nodes, int hops, QVector<int>& seeds) const;
+    static void simulate(QForceNodeLayoutPrivate* d, ForceSimulation& s);
+
+    QForceNodeLayout* q_ptr;
+};
+
+class ForceLayoutTask final : public QRunnable
+{
+public:
+    ForceLayoutTask(QForceNodeLayoutPrivate* d, const ForceSimulation& s)
+        : d_ptr(d), m_Simulation(s) {}
+
+    virtual void run() override;
+
+private:
+    QForceNodeLayoutPrivate* d_ptr;
+    ForceSimulation m_Simulation;
+};
+
+ForceQuadTree::ForceQuadTree(const QVector<QPointF>& positions) :
+    m_lPositions(positions)
+{
+    if (positions.isEmpty())
+        return;
+
+    QRectF bounds(positions.first(), QSizeF());
+
+    for (const auto& p : positions) {
+        bounds.setLeft  (std::min(bounds.left  (), p.x()));
+        bounds.setRight (std::max(bounds.right (), p.x()));
+        bounds.setTop   (std::min(bounds.top   (), p.y()));
+        bounds.setBottom(std::max(bounds.bottom(), p.y()));
+    }
+
+    const qreal half = std::max(bounds.width(), bounds.height()) / 2 + 1;
+
+    m_lCells.reserve(positions.size() * 2);
+    m_lCells << Cell(bounds.center().x(), bounds.center().y(), half);
+
+    for (int i = 0; i < positions.size(); i++)
+        insert(i);
+}
+
+int ForceQuadTree::quadrant(int cell, const QPointF& p) const
+{
+    const Cell& c = m_lCells[cell];
+    return (p.x() >= c.m_X ? 1 : 0) + (p.y() >= c.m_Y ? 2 : 0);
+}
+
+void ForceQuadTree::insert(int body)
+{
+    const QPointF& p = m_lPositions[body];
+
+    int c = 0;
+
+    // Don't hold references to the cells, subdividing reallocates
+    forever {
+        m_lCells[c].m_Mass += 1;
+        m_lCells[c].m_SumX += p.x();
+        m_lCells[c].m_SumY += p.y();
+
+        if (m_lCells[c].m_Child == -1) {
+            if (m_lCells[c].m_Mass == 1) {
+                m_lCells[c].m_Body = body;
+                return;
+            }
+
+            // Coincident points, keep them aggregated
+            if (m_lCells[c].m_Half < force_min_cell) {
+                m_lCells[c].m_Body = -1;
+                return;
+            }
+
+            const qreal h  = m_lCells[c].m_Half / 2;
+            const qreal x  = m_lCells[c].m_X;
+            const qreal y  = m_lCells[c].m_Y;
+            const int   b  = m_lCells[c].m_Body;
+            const int first = m_lCells.size();
+
+            m_lCells << Cell(x - h, y - h, h) << Cell(x + h, y - h, h)
+                     << Cell(x - h, y + h, h) << Cell(x + h, y + h, h);
+
+            m_lCells[c].m_Child = first;
+            m_lCells[c].m_Body  = -1;
+
+            // Move the previous body one level down
+            Cell& moved = m_lCells[first + quadrant(c, m_lPositions[b])];
+            moved.m_Mass = 1;
+            moved.m_SumX = m_lPositions[b].x();
+            moved.m_SumY = m_lPositions[b].y();
+            moved.m_Body = b;
+        }
+
+        c = m_lCells[c].m_Child + quadrant(c, p);
+    }
+}
+
+QPointF ForceQuadTree::repulsion(int self, qreal k2, qreal theta) const
+{
+    const QPointF& p = m_lPositions[self];
+    const qreal theta2 = theta * theta;
+
+    QPointF force;
+
+    QVarLengthArray<int, 128> stack;
+    stack.append(0);
+
+    while (!stack.isEmpty()) {
+        const Cell& c = m_lCells[stack.last()];
+        stack.removeLast();
+
+        if (c.m_Mass == 0 || c.m_Body == self)
+            continue;
+
+        const qreal dx    = p.x() - c.m_SumX / c.m_Mass;
+        const qreal dy    = p.y() - c.m_SumY / c.m_Mass;
+        const qreal dist2 = dx*dx + dy*dy;
+        const qreal size  = 2 * c.m_Half;
+
+        if (c.m_Child == -1 || size*size < theta2 * dist2) {
+            // Fruchterman-Reingold, k^2/d along the normalized direction
+            if (dist2 > 0.01)
+                force += QPointF(dx, dy) * (c.m_Mass * k2 / dist2);
+            else {
+                // Coincident, push in an arbitrary but stable direction
+                force += QPointF((self % 7) - 3, (self % 5) - 2) * c.m_Mass;
+            }
+
+            continue;
+        }
+
+        for (int i = 0; i < 4; i++)
+            stack.append(c.m_Child + i);
+    }
+
+    return force;
+}
+
+QForceNodeLayout::QForceNodeLayout(QNodeEditorSocketModel* model, QObject* parent) :
+    QObject(parent), d_ptr(new QForceNodeLayoutPrivate)
+{
+    Q_ASSERT(model);
+
+    d_ptr->q_ptr    = this;
+    d_ptr->m_pModel = model;
+    d_ptr->m_Pool.setMaxThreadCount(1);
+
+    d_ptr->m_FrameTimer.setInterval(1000 / d_ptr->m_FrameRate);
+
+    connect(&d_ptr->m_FrameTimer, &QTimer::timeout,
+        this, &QForceNodeLayout::slotFrame);
+
+    connect(model, &QAbstractItemModel::rowsInserted,
+        this, &QForceNodeLayout::slotRowsInserted);
+
+    // The node pointers would dangle
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved,
+        this, &QForceNodeLayout::stop);
+    connect(model, &QAbstractItemModel::modelAboutToBeReset,
+        this, &QForceNodeLayout::stop);
+}
+
+QForceNodeLayout::~QForceNodeLayout()
+{
+    d_ptr->m_Stop = 1;
+    d_ptr->m_Pool.waitForDone();
+    delete d_ptr;
+}
+
+qreal QForceNodeLayout::springLength() const
+{
+    return d_ptr->m_SpringLength;
+}
+
+void QForceNodeLayout::setSpringLength(qreal value)
+{
+    d_ptr->m_SpringLength = std::max(value, qreal(1));
+}
+
+qreal QForceNodeLayout::theta() const
+{
+    return d_ptr->m_Theta;
+}
+
+void QForceNodeLayout::setTheta(qreal value)
+{
+    d_ptr->m_Theta = std::max(value, qreal(0));
+}
+
+int QForceNodeLayout::maximumIterations() const
+{
+    return d_ptr->m_MaxIterations;
+}
+
+void QForceNodeLayout::setMaximumIterations(int value)
+{
+    d_ptr->m_MaxIterations = value;
+}
+
+int QForceNodeLayout::frameRate() const
+{
+    return d_ptr->m_FrameRate;
+}
+
+void QForceNodeLayout::setFrameRate(int value)
+{
+    d_ptr->m_FrameRate = std::max(value, 1);
+    d_ptr->m_FrameTimer.setInterval(1000 / d_ptr->m_FrameRate);
+}
+
+bool QForceNodeLayout::isIncremental() const
+{
+    return d_ptr->m_IsIncremental;
+}
+
+void QForceNodeLayout::setIncremental(bool value)
+{
+    d_ptr->m_IsIncremental = value;
+}
+
+bool QForceNodeLayout::isRunning() const
+{
+    return d_ptr->m_IsRunning;
+}
+
+void QForceNodeLayout::start()
+{
+    d_ptr->launch(
+        QVector<bool>(d_ptr->m_pModel->rowCount(), true), {}, false
+    );
+}
+
+void QForceNodeLayout::relax(const QModelIndexList& nodes, int hops)
+{
+    QVector<int> seeds;
+    const auto movable = d_ptr->neighbourhood(nodes, hops, seeds);
+
+    if (!seeds.isEmpty())
+        d_ptr->launch(movable, seeds, false);
+}
+
+void QForceNodeLayout::stop()
+{
+    if (!d_ptr->m_IsRunning)
+        return;
+
+    d_ptr->m_Stop = 1;
+    d_ptr->m_Pool.waitForDone();
+
+    // slotFinished is already queued
+    d_ptr->m_FrameTimer.stop();
+    d_ptr->m_lNodes.clear();
+}
+
+QVector<bool> QForceNodeLayoutPrivate::neighbourhood(const QModelIndexList& nodes, int hops, QVector<int>& seeds) const
+{
+    const int count = m_pModel->rowCount();
+
+    QVector<QVector<int>> adj(count);
+
+    for (const auto& e : m_pModel->edgeModel()->nodeConnections()) {
+        adj[e.first ] << e.second;
+        adj[e.second] << e.first;
+    }
+
+    QVector<int> depth(count, -1);
+
+    for (const auto& idx : qAsConst(nodes)) {
+        if (idx.model() != m_pModel || idx.parent().isValid())
+            continue;
+
+        if (depth[idx.row()] == -1) {
+            depth[idx.row()] = 0;
+            seeds << idx.row();
+        }
+    }
+
+    // Breadth first, up to `hops` away
+    QVector<int> queue = seeds;
+
+    for (int i = 0; i < queue.size(); i++) {
+        const int u = queue[i];
+
+        if (depth[u] == hops)
+            continue;
+
+        for (const int v : qAsConst(adj[u])) {
+            if (depth[v] == -1) {
+                depth[v] = depth[u] + 1;
+                queue << v;
+            }
+        }
+    }
+
+    QVector<bool> movable(count);
+
+    for (int i = 0; i < count; i++)
+        movable[i] = depth[i] != -1;
+
+    return movable;
+}
+
+void QForceNodeLayoutPrivate::launch(const QVector<bool>& movable, const QVector<int>& seeds, bool place)
+{
+    if (m_IsRunning) {
+        m_Stop = 1;
+        m_Pool.waitForDone();
+    }
+
+    const int count = m_pModel->rowCount();
+
+    if (!count)
+        return;
+
+    ForceSimulation s;
+    s.m_K             = m_SpringLength;
+    s.m_Theta         = m_Theta;
+    s.m_MaxIterations = m_MaxIterations;
+    s.m_lMovable      = movable;
+
+    m_lNodes.resize(count);
+    m_lSizes.resize(count);
+    s.m_lPositions.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        m_lNodes[i] = m_pModel->getNode(m_pModel->index(i, 0));
+
+        const QRectF r = m_lNodes[i] ? m_lNodes[i]->rect() : QRectF();
+
+        m_lSizes[i] = r.size();
+        s.m_lPositions[i] = r.center();
+
+        if (!m_lNodes[i])
+            s.m_lMovable[i] = false;
+    }
+
+    // CSR adjacency
+    const auto edges = m_pModel->edgeModel()->nodeConnections();
+
+    s.m_lAdjStart.fill(0, count + 1);
+
+    for (const auto& e : edges) {
+        s.m_lAdjStart[e.first  + 1]++;
+        s.m_lAdjStart[e.second + 1]++;
+    }
+
+    for (int i = 0; i < count; i++)
+        s.m_lAdjStart[i + 1] += s.m_lAdjStart[i];
+
+    s.m_lAdj.resize(s.m_lAdjStart[count]);
+
+    QVector<int> fill(s.m_lAdjStart);
+
+    for (const auto& e : edges) {
+        s.m_lAdj[fill[e.first ]++] = e.second;
+        s.m_lAdj[fill[e.second]++] = e.first;
+    }
+
+    // Put the new nodes next to the existing neighbours, the simulation only
+    // has to fix the local overlaps
+    if (place) {
+        QVector<bool> isSeed(count, false);
+
+        for (const int i : seeds)
+            isSeed[i] = true;
+
+        for (const int i : seeds) {
+            QPointF sum;
+            int     n = 0;
+
+            for (int j = s.m_lAdjStart[i]; j < s.m_lAdjStart[i + 1]; j++) {
+                if (!isSeed[s.m_lAdj[j]]) {
+                    sum += s.m_lPositions[s.m_lAdj[j]];
+                    n++;
+                }
+            }
+
+            if (n) {
+                const qreal angle = i * 2.39996; // golden angle
+                s.m_lPositions[i] = sum / n + QPointF(
+                    std::cos(angle), std::sin(angle)
+                ) * (m_SpringLength / 2);
+            }
+        }
+    }
+
+    m_lMovable = s.m_lMovable;
+    m_Stop     = 0;
+    m_HasFrame = false;
+
+    m_IsRunning = true;
+    m_Queued++;
+    m_Pool.start(new ForceLayoutTask(this, s));
+    m_FrameTimer.start();
+}
+
+void QForceNodeLayoutPrivate::simulate(QForceNodeLayoutPrivate* d, ForceSimulation& s)
+{
+    const int   count = s.m_lPositions.size();
+    const int   tasks = (count + force_chunk - 1) / force_chunk;
+    const qreal k     = s.m_K;
+    const qreal k2    = k * k;
+
+    QVector<QPointF> displacement(count);
+
+    // Maximum displacement per iteration, cools down linearly
+    const qreal initialTemperature = k * 2;
+    qreal temperature = initialTemperature;
+
+    for (int iter = 0; iter < s.m_MaxIterations && !d->m_Stop; iter++) {
+        const ForceQuadTree tree(s.m_lPositions);
+
+        const QPointF* pos   = s.m_lPositions.constData();
+        const int*     start = s.m_lAdjStart.constData();
+        const int*     adj   = s.m_lAdj.constData();
+        const bool*    mov   = s.m_lMovable.constData();
+        QPointF*       disp  = displacement.data();
+
+        parallelFor(tasks, [&](int t) {
+            const int end = std::min(count, (t + 1) * force_chunk);
+
+            for (int i = t * force_chunk; i < end; i++) {
+                if (!mov[i])
+                    continue;
+
+                QPointF f = tree.repulsion(i, k2, s.m_Theta);
+
+                // Springs, d^2/k toward the neighbour
+                for (int j = start[i]; j < start[i + 1]; j++) {
+                    const QPointF delta = pos[adj[j]] - pos[i];
+                    const qreal   dist  = std::sqrt(
+                        delta.x()*delta.x() + delta.y()*delta.y()
+                    );
+
+                    f += delta * (dist / k);
+                }
+
+                disp[i] = f;
+            }
+        });
+
+        qreal maxMove = 0;
+
+        for (int i = 0; i < count; i++) {
+            if (!mov[i])
+                continue;
+
+            const QPointF& f   = disp[i];
+            const qreal    len = std::sqrt(f.x()*f.x() + f.y()*f.y());
+
+            if (len < 1e-9)
+                continue;
+
+            const qreal move = std::min(len, temperature);
+            s.m_lPositions[i] += f * (move / len);
+            maxMove = std::max(maxMove, move);
+        }
+
+        d->publish(s.m_lPositions);
+
+        if (maxMove < force_epsilon)
+            break;
+
+        temperature = std::max(
+            initialTemperature * (1 - qreal(iter + 1) / s.m_MaxIterations),
+            force_epsilon
+        );
+    }
+}
+
+void ForceLayoutTask::run()
+{
+    QForceNodeLayoutPrivate::simulate(d_ptr, m_Simulation);
+
+    QMetaObject::invokeMethod(d_ptr->q_ptr, "slotFinished", Qt::QueuedConnection);
+}
+
+void QForceNodeLayoutPrivate::publish(const QVector<QPointF>& centers)
+{
+    QMutexLocker l(&m_Mutex);
+    m_lFrame   = centers;
+    m_HasFrame = true;
+}
+
+void QForceNodeLayoutPrivate::applyFrame(const QVector<QPointF>& centers)
+{
+    // The model changed, the indices are no longer valid
+    if (centers.size() != m_lNodes.size() || m_lNodes.size() != m_pModel->rowCount())
+        return;
+
+    m_pModel->beginBatchUpdate();
+
+    for (int i = 0; i < centers.size(); i++) {
+        if (!m_lMovable[i])
+            continue;
+
+        const QSizeF& size = m_lSizes[i];
+
+        m_lNodes[i]->setRect(QRectF(
+            centers[i] - QPointF(size.width(), size.height()) / 2, size
+        ));
+    }
+
+    m_pModel->endBatchUpdate();
+}
+
+void QForceNodeLayout::slotFrame()
+{
+    QVector<QPointF> centers;
+
+    {
+        QMutexLocker l(&d_ptr->m_Mutex);
+
+        if (!d_ptr->m_HasFrame)
+            return;
+
+        centers.swap(d_ptr->m_lFrame);
+        d_ptr->m_HasFrame = false;
+    }
+
+    d_ptr->applyFrame(centers);
+}
+
+void QForceNodeLayout::slotFinished()
+{
+    // A newer simulation was started in the meantime
+    if (--d_ptr->m_Queued)
+        return;
+
+    slotFrame();
+
+    d_ptr->m_FrameTimer.stop();
+    d_ptr->m_IsRunning = false;
+
+    Q_EMIT finished();
+
+    // Nodes were inserted while running
+    if (d_ptr->m_IsIncremental && !d_ptr->m_lInserted.isEmpty())
+        QTimer::singleShot(0, this, [this]() {
+            slotRowsInserted({}, 0, -1);
+        });
+}
+
+void QForceNodeLayout::slotRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    if (!d_ptr->m_IsIncremental || parent.isValid())
+        return;
+
+    const bool schedule = d_ptr->m_lInserted.isEmpty();
+
+    for (int i = first; i <= last; i++)
+        d_ptr->m_lInserted << QPersistentModelIndex(d_ptr->m_pModel->index(i, 0));
+
+    // Wait for the sockets and edges to be inserted too
+    if (!schedule && first <= last)
+        return;
+
+    QTimer::singleShot(0, this, [this]() {
+        if (d_ptr->m_IsRunning || d_ptr->m_lInserted.isEmpty())
+            return;
+
+        QModelIndexList nodes;
+
+        for (const auto& idx : qAsConst(d_ptr->m_lInserted)) {
+            if (idx.isValid())
+                nodes << idx;
+        }
+
+        d_ptr->m_lInserted.clear();
+
+        QVector<int> seeds;
+        const auto movable = d_ptr->neighbourhood(nodes, 2, seeds);
+
+        if (!seeds.isEmpty())
+            d_ptr->launch(movable, seeds, true);
+    });
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QModelIndexList>
+
+class QNodeEditorSocketModel;
+
+class QForceNodeLayoutPrivate;
+
+/**
+ * Force directed automatic layout.
+ *
+ * The edges act as springs and all nodes repel each other. The repulsion is
+ * approximated using a Barnes-Hut quadtree, so each step is O(n log n), and
+ * the forces are accumulated on all cores.
+ *
+ * The simulation runs on a worker thread. The intermediate positions are
+ * applied to the nodes at most frameRate() times per second, so the graph
+ * can be watched converging without saturating the GUI thread.
+ *
+ * In incremental mode, the nodes inserted in the model are placed next to
+ * their neighbours and only their neighbourhood is relaxed, the rest of the
+ * graph doesn't move.
+ */
+class Q_DECL_EXPORT QForceNodeLayout : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QForceNodeLayout(QNodeEditorSocketModel* model, QObject* parent = Q_NULLPTR);
+    virtual ~QForceNodeLayout();
+
+    /// Ideal edge length, in scene units
+    qreal springLength() const;
+    void setSpringLength(qreal value);
+
+    /// Barnes-Hut opening angle, 0 is exact and slow, higher is coarser
+    qreal theta() const;
+    void setTheta(qreal value);
+
+    int maximumIterations() const;
+    void setMaximumIterations(int value);
+
+    /// Maximum number of position updates applied per second
+    int frameRate() const;
+    void setFrameRate(int value);
+
+    bool isIncremental() const;
+    void setIncremental(bool value);
+
+    bool isRunning() const;
+
+public Q_SLOTS:
+    /// Layout the whole graph
+    void start();
+
+    /**
+     * Only move the given nodes and the ones up to hops edges away from
+     * them. The others still repel them but stay in place.
+     */
+    void relax(const QModelIndexList& nodes, int hops = 2);
+
+    /// Keep the current (intermediate) positions
+    void stop();
+
+Q_SIGNALS:
+    void finished();
+
+private Q_SLOTS:
+    void slotFrame();
+    void slotFinished();
+    void slotRowsInserted(const QModelIndex& parent, int first, int last);
+
+private:
+    QForceNodeLayoutPrivate* d_ptr;
+    Q_DECLARE_PRIVATE(QForceNodeLayout)
+};
@@ -0,0 +1,387 @@
+#include "qlayerednodelayout.h"
+
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+#include <QtCore/QPair>
+
+#include <algorithm>
+#include <limits>
+
+#include "graphicsnode.hpp"
+#include "qnodeeditorsocketmodel.h"
+#include "parallelfor_p.h"
+
+#if QT_VERSION < 0x050700
+//Q_FOREACH is deprecated and Qt CoW containers are detached on C++11 for loops
+template<typename T>
+const T& qAsConst(const T& v)
+{
+    return const_cast<const T&>(v);
+}
+#endif
+
+typedef QPair<int, int> Edge;
+
+class QLayeredNodeLayoutPrivate final
+{
+public:
+    // A node or a virtual node splitting a long edge
+    struct Vertex {
+        QSizeF       m_Size   {0, 0};
+        int          m_Layer  {0};
+        int          m_Order  {0};
+        qreal        m_Y      {0};
+        QVector<int> m_lUp    {};
+        QVector<int> m_lDown  {};
+    };
+
+    QNodeEditorSocketModel* m_pModel;
+
+    qreal m_LayerSpacing {80.0};
+    qreal m_NodeSpacing  {20.0};
+    int   m_SweepCount   {8   };
+
+    // Helpers
+    void readGraph(QVector<GraphicsNode*>& nodes, QVector<Edge>& edges) const;
+    static void breakCycles(int count, QVector<Edge>& edges);
+    static QVector<int> assignLayers(int count, const QVector<Edge>& edges);
+    void minimizeCrossings(QVector<Vertex>& vertices, QVector<QVector<int>>& layers) const;
+    void assignCoordinates(QVector<Vertex>& vertices, const QVector<QVector<int>>& layers) const;
+
+    // Run f(layer) on all layers with the same parity concurrently, the
+    // other layers are only read
+    template<typename F>
+    static void forEachParity(int layerCount, int parity, const F& f);
+};
+
+QLayeredNodeLayout::QLayeredNodeLayout(QNodeEditorSocketModel* model) :
+    d_ptr(new QLayeredNodeLayoutPrivate)
+{
+    Q_ASSERT(model);
+    d_ptr->m_pModel = model;
+}
+
+QLayeredNodeLayout::~QLayeredNodeLayout()
+{
+    delete d_ptr;
+}
+
+qreal QLayeredNodeLayout::layerSpacing() const
+{
+    return d_ptr->m_LayerSpacing;
+}
+
+void QLayeredNodeLayout::setLayerSpacing(qreal value)
+{
+    d_ptr->m_LayerSpacing = value;
+}
+
+qreal QLayeredNodeLayout::nodeSpacing() const
+{
+    return d_ptr->m_NodeSpacing;
+}
+
+void QLayeredNodeLayout::setNodeSpacing(qreal value)
+{
+    d_ptr->m_NodeSpacing = value;
+}
+
+int QLayeredNodeLayout::sweepCount() const
+{
+    return d_ptr->m_SweepCount;
+}
+
+void QLayeredNodeLayout::setSweepCount(int value)
+{
+    d_ptr->m_SweepCount = value;
+}
+
+template<typename F>
+void QLayeredNodeLayoutPrivate::forEachParity(int layerCount, int parity, const F& f)
+{
+    parallelFor((layerCount - parity + 1) / 2, [&f, parity](int i) {
+        f(i*2 + parity);
+    });
+}
+
+void QLayeredNodeLayoutPrivate::readGraph(QVector<GraphicsNode*>& nodes, QVector<Edge>& edges) const
+{
+    const int count = m_pModel->rowCount();
+
+    nodes.resize(count);
+
+    for (int i = 0; i < count; i++)
+        nodes[i] = m_pModel->getNode(m_pModel->index(i, 0));
+
+    edges = m_pModel->edgeModel()->nodeConnections();
+}
+
+void QLayeredNodeLayoutPrivate::breakCycles(int count, QVector<Edge>& edges)
+{
+    QVector<QVector<int>> out(count);
+
+    for (int i = 0; i < edges.size(); i++)
+        out[edges[i].first] << i;
+
+    // 0: not visited, 1: on the stack, 2: done
+    QVector<char> state(count, 0);
+
+    // Iterative DFS, the graphs can be deep
+    QVector<QPair<int, int>> stack;
+
+    for (int root = 0; root < count; root++) {
+        if (state[root])
+            continue;
+
+        stack << qMakePair(root, 0);
+        state[root] = 1;
+
+        while (!stack.isEmpty()) {
+            auto& top = stack.last();
+            const int u = top.first;
+
+            if (top.second == out[u].size()) {
+                state[u] = 2;
+                stack.removeLast();
+                continue;
+            }
+
+            const int e = out[u][top.second++];
+            const int v = edges[e].second;
+
+            if (state[v] == 1)
+                edges[e] = Edge(v, u); // back edge
+            else if (!state[v]) {
+                state[v] = 1;
+                stack << qMakePair(v, 0);
+            }
+        }
+    }
+}
+
+QVector<int> QLayeredNodeLayoutPrivate::assignLayers(int count, const QVector<Edge>& edges)
+{
+    QVector<QVector<int>> out(count);
+    QVector<int> inDegree(count, 0), layer(count, 0);
+
+    for (const auto& e : edges) {
+        out[e.first] << e.second;
+        inDegree[e.second]++;
+    }
+
+    // Kahn, in topological order each node is after all its predecessors
+    QVector<int> queue;
+    queue.reserve(count);
+
+    for (int i = 0; i < count; i++) {
+        if (!inDegree[i])
+            queue << i;
+    }
+
+    for (int i = 0; i < queue.size(); i++) {
+        const int u = queue[i];
+
+        for (const int v : qAsConst(out[u])) {
+            layer[v] = std::max(layer[v], layer[u] + 1);
+
+            if (!--inDegree[v])
+                queue << v;
+        }
+    }
+
+    return layer;
+}
+
+void QLayeredNodeLayoutPrivate::minimizeCrossings(QVector<Vertex>& vertices, QVector<QVector<int>>& layers) const
+{
+    Vertex* vs = vertices.data();
+    QVector<int>* ls = layers.data();
+
+    for (int sweep = 0; sweep < m_SweepCount; sweep++) {
+        for (int parity = 0; parity < 2; parity++) {
+            forEachParity(layers.size(), parity, [vs, ls](int l) {
+                QVector<int>& layer = ls[l];
+                QVector<QPair<qreal, int>> bary(layer.size());
+
+                for (int i = 0; i < layer.size(); i++) {
+                    const Vertex& v = vs[layer[i]];
+                    qreal sum = 0;
+
+                    for (const int n : v.m_lUp  ) sum += vs[n].m_Order;
+                    for (const int n : v.m_lDown) sum += vs[n].m_Order;
+
+                    const int degree = v.m_lUp.size() + v.m_lDown.size();
+
+                    bary[i] = qMakePair(degree ? sum / degree : qreal(v.m_Order), layer[i]);
+                }
+
+                std::stable_sort(bary.begin(), bary.end(),
+                    [](const QPair<qreal, int>& a, const QPair<qreal, int>& b) {
+                        return a.first < b.first;
+                });
+
+                for (int i = 0; i < layer.size(); i++) {
+                    layer[i] = bary[i].second;
+                    vs[layer[i]].m_Order = i;
+                }
+            });
+        }
+    }
+}
+
+void QLayeredNodeLayoutPrivate::assignCoordinates(QVector<Vertex>& vertices, const QVector<QVector<int>>& layers) const
+{
+    Vertex* vs = vertices.data();
+    const QVector<int>* ls = layers.data();
+    const qreal spacing = m_NodeSpacing;
+
+    // Stack everything
+    for (const auto& layer : layers) {
+        qreal y = 0;
+
+        for (const int v : layer) {
+            vs[v].m_Y = y;
+            y += vs[v].m_Size.height() + spacing;
+        }
+    }
+
+    // Pull each node toward the center of its neighbours. Going down pushes
+    // the overlapping nodes down and going up pushes them up, the average of
+    // both keeps the layer centered.
+    for (int iter = 0; iter < 4; iter++) {
+        for (int parity = 0; parity < 2; parity++) {
+            forEachParity(layers.size(), parity, [vs, ls, spacing](int l) {
+                const QVector<int>& layer = ls[l];
+                const int count = layer.size();
+
+                if (!count)
+                    return;
+
+                QVector<qreal> desired(count), down(count), up(count);
+
+                for (int i = 0; i < count; i++) {
+                    const Vertex& v = vs[layer[i]];
+                    qreal sum = 0;
+
+                    for (const int n : v.m_lUp  ) sum += vs[n].m_Y + vs[n].m_Size.height()/2;
+                    for (const int n : v.m_lDown) sum += vs[n].m_Y + vs[n].m_Size.height()/2;
+
+                    const int degree = v.m_lUp.size() + v.m_lDown.size();
+
+                    desired[i] = degree ?
+                        sum / degree - v.m_Size.height()/2 : v.m_Y;
+                }
+
+                qreal bottom = -std::numeric_limits<qreal>::max();
+
+                for (int i = 0; i < count; i++) {
+                    down[i] = std::max(desired[i], bottom);
+                    bottom  = down[i] + vs[layer[i]].m_Size.height() + spacing;
+                }
+
+                qreal top = std::numeric_limits<qreal>::max();
+
+                for (int i = count - 1; i >= 0; i--) {
+                    const qreal h = vs[layer[i]].m_Size.height();
+                    up[i] = std::min(desired[i], top - h);
+                    top   = up[i] - spacing;
+                }
+
+                // The average might overlap, push down again
+                bottom = -std::numeric_limits<qreal>::max();
+
+                for (int i = 0; i < count; i++) {
+                    Vertex& v = vs[layer[i]];
+                    v.m_Y  = std::max((down[i] + up[i]) / 2, bottom);
+                    bottom = v.m_Y + v.m_Size.height() + spacing;
+                }
+            });
+        }
+    }
+}
+
+void QLayeredNodeLayout::apply()
+{
+    QVector<GraphicsNode*> nodes;
+    QVector<Edge>          edges;
+
+    d_ptr->readGraph(nodes, edges);
+
+    const int count = nodes.size();
+
+    if (!count)
+        return;
+
+    QLayeredNodeLayoutPrivate::breakCycles(count, edges);
+
+    const QVector<int> layerOf = QLayeredNodeLayoutPrivate::assignLayers(count, edges);
+
+    QVector<QLayeredNodeLayoutPrivate::Vertex> vertices(count);
+
+    int layerCount = 0;
+
+    for (int i = 0; i < count; i++) {
+        vertices[i].m_Layer = layerOf[i];
+        vertices[i].m_Size  = nodes[i] ? nodes[i]->size() : QSizeF();
+        layerCount = std::max(layerCount, layerOf[i] + 1);
+    }
+
+    // Split the long edges so each edge links adjacent layers
+    for (const auto& e : qAsConst(edges)) {
+        int prev = e.first;
+
+        for (int l = layerOf[e.first] + 1; l < layerOf[e.second]; l++) {
+            QLayeredNodeLayoutPrivate::Vertex dummy;
+            dummy.m_Layer = l;
+            dummy.m_lUp << prev;
+            vertices << dummy;
+
+            const int id = vertices.size() - 1;
+            vertices[prev].m_lDown << id;
+            prev = id;
+        }
+
+        vertices[prev].m_lDown << e.second;
+        vertices[e.second].m_lUp << prev;
+    }
+
+    QVector<QVector<int>> layers(layerCount);
+
+    for (int i = 0; i < vertices.size(); i++) {
+        vertices[i].m_Order = layers[vertices[i].m_Layer].size();
+        layers[vertices[i].m_Layer] << i;
+    }
+
+    d_ptr->minimizeCrossings(vertices, layers);
+    d_ptr->assignCoordinates(vertices, layers);
+
+    // Columns
+    QVector<qreal> layerX(layerCount, 0);
+    qreal minY = std::numeric_limits<qreal>::max();
+
+    for (int l = 0; l < layerCount; l++) {
+        qreal width = 0;
+
+        for (const int v : qAsConst(layers[l])) {
+            width = std::max(width, vertices[v].m_Size.width());
+            minY  = std::min(minY, vertices[v].m_Y);
+        }
+
+        if (l + 1 < layerCount)
+            layerX[l + 1] = layerX[l] + width + d_ptr->m_LayerSpacing;
+    }
+
+    d_ptr->m_pModel->beginBatchUpdate();
+
+    for (int i = 0; i < count; i++) {
+        if (!nodes[i])
+            continue;
+
+        nodes[i]->setRect(QRectF(
+            QPointF(layerX[vertices[i].m_Layer], vertices[i].m_Y - minY),
+            vertices[i].m_Size
+        ));
+    }
+
+    d_ptr->m_pModel->endBatchUpdate();
+}
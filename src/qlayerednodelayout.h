@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QtCore/QtGlobal>
+
+class QNodeEditorSocketModel;
+
+class QLayeredNodeLayoutPrivate;
+
+/**
+ * Layered (Sugiyama style) automatic layout.
+ *
+ * The topology is read from the edge model and the sizes from the nodes. The
+ * data flows from left to right: each layer is a column and the sources of
+ * an edge are always in a column on the left of its sinks.
+ *
+ * The steps are:
+ *
+ *  * Break the cycles by reversing the DFS back edges
+ *  * Assign the layers using the longest path
+ *  * Split the edges spanning many layers with virtual nodes
+ *  * Minimize the crossings with barycenter sweeps. The odd and even layers
+ *    are alternatively reordered, each layer of a pass on its own thread
+ *  * Assign the coordinates by pulling each node toward its neighbours
+ *    while keeping the order and spacing within the layer
+ */
+class Q_DECL_EXPORT QLayeredNodeLayout final
+{
+public:
+    explicit QLayeredNodeLayout(QNodeEditorSocketModel* model);
+    ~QLayeredNodeLayout();
+
+    /// Horizontal space between two layers
+    qreal layerSpacing() const;
+    void setLayerSpacing(qreal value);
+
+    /// Vertical space between two nodes of the same layer
+    qreal nodeSpacing() const;
+    void setNodeSpacing(qreal value);
+
+    /// Number of crossing minimization iterations
+    int sweepCount() const;
+    void setSweepCount(int value);
+
+    /**
+     * Compute the layout and move all nodes in one batched update.
+     */
+    void apply();
+
+private:
+    QLayeredNodeLayoutPrivate* d_ptr;
+    Q_DECLARE_PRIVATE(QLayeredNodeLayout)
+};
@@ -3,87 +3,223 @@
 #include <QtCore/QMimeData>
 #include <QtCore/QDataStream>
 #include <QtCore/QDebug>
+#include <QtCore/QVector>
 
-// Be less strict about unserializable values that are part of the stream.
-class QLousyVariantDecoder
+// The QVariant header of a role, the value is only decoded when requested.
+struct RoleEntry
 {
-public:
-    class QVariantExt : public QVariant {
-    public:
-        inline void createProxy(int typeId) { create(typeId, Q_NULLPTR); }
-    };
-
-    quint32     metaType;
-    qint8       isNull;
-    QVariantExt variant ;
-    QByteArray  userType;
-    bool        isLoaded;
+    int      m_Role;
+    quint32  m_MetaType;
+    qint8    m_IsNull;
+    qint64   m_Offset; // of the value in the buffer
+    bool     m_IsLoaded;
+    QVariant m_Value;
+};
+
+struct ElementEntry
+{
+    int                m_Row;
+    int                m_Column;
+    QVector<RoleEntry> m_lRoles;
 };
 
 class QModelDataListDecoderPrivate
 {
 public:
-    QHash<QPair<int, int>, QMap<int, QLousyVariantDecoder> > m_Data;
+    QByteArray m_Buffer;
+    qint64     m_Position {0};
+    bool       m_IsAtEnd  {true};
+
+    // In stream order, usually there is only one
+    QVector<ElementEntry> m_lElements;
+
+    // Helpers
+    bool parseNext();
+    ElementEntry* element(int row, int col);
+    RoleEntry* entry(int role, int row, int col);
+    QVariant value(RoleEntry* e);
+    static bool skip(QDataStream& s, quint32 metaType);
+    static bool loadValue(QDataStream& s, RoleEntry& e);
 };
 
-QDebug operator<<(QDebug debug, const QLousyVariantDecoder &v);
-QDataStream &operator<<(QDataStream &s, const QLousyVariantDecoder &self);
-QDataStream &operator>>(QDataStream &s, QLousyVariantDecoder &self);
+/**
+ * Skip the values with a known size. Those are most of what the models
+ * return. The others have to be decoded to know where they end.
+ */
+bool QModelDataListDecoderPrivate::skip(QDataStream& s, quint32 metaType)
+{
+    int size = 0;
+
+    switch (metaType) {
+        case QMetaType::Bool:
+        case QMetaType::Char:
+        case QMetaType::SChar:
+        case QMetaType::UChar:
+            size = 1;
+            break;
+        case QMetaType::Short:
+        case QMetaType::UShort:
+        case QMetaType::QChar:
+            size = 2;
+            break;
+        case QMetaType::Int:
+        case QMetaType::UInt:
+            size = 4;
+            break;
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Double:
+        case QMetaType::QSize:
+        case QMetaType::QPoint:
+            size = 8;
+            break;
+        case QMetaType::QSizeF:
+        case QMetaType::QPointF:
+        case QMetaType::QRect:
+        case QMetaType::QLine:
+            size = 16;
+            break;
+        case QMetaType::QRectF:
+        case QMetaType::QLineF:
+            size = 32;
+            break;
+        case QMetaType::QString:
+        case QMetaType::QByteArray: {
+            // The size in bytes, 0xFFFFFFFF for null
+            quint32 len;
+            s >> len;
+            size = len == 0xFFFFFFFF ? 0 : int(len);
+            break;
+        }
+        default:
+            return false;
+    }
 
-QDebug operator<<(QDebug debug, const QLousyVariantDecoder &v)
+    return s.skipRawData(size) == size;
+}
+
+bool QModelDataListDecoderPrivate::loadValue(QDataStream& s, RoleEntry& e)
 {
-    return debug << QStringLiteral("<<<")
-        << QStringLiteral("Type:"      ) << v.metaType << v.userType
-        << QStringLiteral(", Is NULL:" ) << v.isNull
-        << QStringLiteral(", Is valid:") << v.isLoaded
-        << QStringLiteral(", Value:"   ) << v.variant
-        << QStringLiteral(">>>");
+    e.m_Value    = QVariant(int(e.m_MetaType), Q_NULLPTR);
+    e.m_IsLoaded = true;
+
+    return QMetaType::load(s, e.m_MetaType, const_cast<void*>(e.m_Value.constData()));
 }
 
-QDataStream &operator<<(QDataStream &s, const QLousyVariantDecoder &self)
+/*
+ * Each element is:
+ *
+ *  * The row and column (int)
+ *  * The number of roles (quint32)
+ *  * The role (int) and a QVariant for each of them
+ *
+ * There is no Qt ways to decode the QVariants partially, so their header
+ * is parsed by hand. Also, QVariant::load exits early when decoding a
+ * QMetaType that cannot be decoded and the type would be lost.
+ */
+bool QModelDataListDecoderPrivate::parseNext()
 {
-    return s << self.variant;
+    if (m_IsAtEnd)
+        return false;
+
+    QDataStream s(m_Buffer);
+    s.device()->seek(m_Position);
+
+    ElementEntry elem;
+    quint32 count;
+
+    s >> elem.m_Row >> elem.m_Column >> count;
+
+    elem.m_lRoles.reserve(int(qMin(count, quint32(32))));
+
+    for (quint32 i = 0; i < count && s.status() == QDataStream::Ok; i++) {
+        RoleEntry e {0, QMetaType::UnknownType, 0, -1, false, {}};
+
+        s >> e.m_Role >> e.m_MetaType >> e.m_IsNull;
+
+        if (e.m_MetaType == QVariant::UserType) {
+            QByteArray name;
+            s >> name;
+            e.m_MetaType = QMetaType::type(name.constData());
+
+            // The size of the value is unknown, nothing after can be read
+            if (e.m_MetaType == QMetaType::UnknownType) {
+                s.setStatus(QDataStream::ReadCorruptData);
+                break;
+            }
+        }
+
+        if (e.m_MetaType != QMetaType::UnknownType) {
+            e.m_Offset = s.device()->pos();
+
+            // The values of the types without stream operators are not
+            // saved, so there is nothing to skip when loading them fails
+            if (!skip(s, e.m_MetaType))
+                loadValue(s, e);
+        }
+
+        elem.m_lRoles << e;
+    }
+
+    m_Position = s.device()->pos();
+    m_IsAtEnd  = s.status() != QDataStream::Ok || s.atEnd();
+
+    // Only keep the valid items
+    if (elem.m_Row+1 && elem.m_Column+1)
+        m_lElements << elem;
+
+    return true;
 }
 
-QDataStream &operator>>(QDataStream &s, QLousyVariantDecoder &self)
+ElementEntry* QModelDataListDecoderPrivate::element(int row, int col)
 {
-    // There is no Qt ways to doing this before 5.7 beside creating it by hand
-    // Qt5.7 support transactions, but replicating the exact behavior of the
-    // following code is longer than not using transactions.
-    s >> self.metaType;
-    s >> self.isNull;
-
-    if (self.metaType == QVariant::UserType) {
-        s >> self.userType;
-        self.metaType = QMetaType::type(self.userType.constData());
-
-        if (self.metaType == QMetaType::UnknownType) {
-            s.setStatus(QDataStream::ReadCorruptData);
-            return s;
+    const bool first = !(row+1 && col+1);
+
+    int i = 0;
+
+    forever {
+        for (; i < m_lElements.size(); i++) {
+            auto& e = m_lElements[i];
+
+            if (first || (e.m_Row == row && e.m_Column == col))
+                return &e;
         }
+
+        if (!parseNext())
+            return Q_NULLPTR;
     }
-    else
-        self.userType = QMetaType::typeName(self.metaType);
+}
 
-    if (!self.isNull) {
-        self.variant.createProxy(self.metaType);
+RoleEntry* QModelDataListDecoderPrivate::entry(int role, int row, int col)
+{
+    const auto elem = element(row, col);
 
-        void* data = const_cast<void *>(self.variant.constData());
+    if (!elem)
+        return Q_NULLPTR;
 
-        // Ignore errors, as the way it is implemented, the field is empty,
-        // so the streams remains valid. However dropping the data wont work.
-        self.isLoaded = QMetaType::load(s, self.variant.type(), data);
+    for (auto& e : elem->m_lRoles) {
+        if (e.m_Role == role)
+            return &e;
     }
 
-    return s;
+    return Q_NULLPTR;
 }
 
-// hack to execute code at a RANDOM moment during initialization.
-static auto _DUMMY = ([]()->bool {
-    qRegisterMetaType               <QLousyVariantDecoder>("QLousyVariantDecoder");
-    qRegisterMetaTypeStreamOperators<QLousyVariantDecoder>("QLousyVariantDecoder");
-    return true;
-})();
+QVariant QModelDataListDecoderPrivate::value(RoleEntry* e)
+{
+    if (e->m_IsLoaded)
+        return e->m_Value;
+
+    if (e->m_Offset == -1)
+        return {};
+
+    QDataStream s(m_Buffer);
+    s.device()->seek(e->m_Offset);
+
+    loadValue(s, *e);
+
+    return e->m_Value;
+}
 
 QModelDataListDecoder::QModelDataListDecoder(const QMimeData* data)
     : d_ptr(new QModelDataListDecoderPrivate)
@@ -91,23 +227,10 @@ QModelDataListDecoder::QModelDataListDecoder(const QMimeData* data)
     if (!data)
         return;
 
-    // Check all payloads if one can be converted to the right QMetaType
-    auto buf = data->data("application/x-qabstractitemmodeldatalist");
-
-    if (buf.isEmpty())
-        return;
-
-    QDataStream s(buf);
-
-    while (!s.atEnd()) {
-        int r, c;
-        QMap<int, QLousyVariantDecoder> v;
-        s >> r >> c >> v;
-
-        // only add valid items
-        if (r+1 && c+1)
-            d_ptr->m_Data[{r, c}] = std::move(v);
-    }
+    // Nothing is decoded until requested, usually only the first element
+    // type is needed
+    d_ptr->m_Buffer  = data->data("application/x-qabstractitemmodeldatalist");
+    d_ptr->m_IsAtEnd = d_ptr->m_Buffer.isEmpty();
 }
 
 QModelDataListDecoder::~QModelDataListDecoder()
@@ -117,56 +240,45 @@ QModelDataListDecoder::~QModelDataListDecoder()
 
 QPair<int, int> QModelDataListDecoder::firstElement() const
 {
-    if (d_ptr->m_Data.isEmpty())
+    const auto elem = d_ptr->element(-1, -1);
+
+    if (!elem)
         return {-1,-1};
 
-    return d_ptr->m_Data.begin().key();
+    return {elem->m_Row, elem->m_Column};
 }
 
 bool QModelDataListDecoder::canConvert(quint32 typeId, int role, int row, int col) const
 {
-    auto v = data(role, row, col);
-
-    if (v.isValid())
-        return v.canConvert(typeId);
+    const auto e = d_ptr->entry(role, row, col);
 
-    const auto pair = (row+1&&col+1) ? QPair<int,int>(row, col) : firstElement();
-
-    if (!d_ptr->m_Data.contains(pair))
+    if (!e)
         return false;
 
-    auto info = d_ptr->m_Data[pair][role];
-
-    if (info.metaType == typeId)
+    if (e->m_MetaType == typeId)
         return true;
 
-    QLousyVariantDecoder::QVariantExt var;
-    var.createProxy(info.metaType);
+    // The QObject conversions depend on the object, not only its type
+    if (QMetaType::typeFlags(e->m_MetaType) & QMetaType::PointerToQObject) {
+        const auto v = d_ptr->value(e);
 
-    return var.canConvert(typeId);;
+        if (v.isValid())
+            return v.canConvert(typeId);
+    }
+
+    return QVariant(int(e->m_MetaType), Q_NULLPTR).canConvert(typeId);
 }
 
 QVariant QModelDataListDecoder::data(int role, int row, int col) const
 {
-    const auto pair = (row+1&&col+1) ? QPair<int,int>(row, col) : firstElement();
-
-    if (!d_ptr->m_Data.contains(pair))
-        return {};
+    const auto e = d_ptr->entry(role, row, col);
 
-    return d_ptr->m_Data[pair][role].variant;
+    return e ? d_ptr->value(e) : QVariant();
 }
 
 quint32 QModelDataListDecoder::typeId(int role, int row, int col) const
 {
-    const auto pair = (row+1&&col+1) ? QPair<int,int>(row, col) : firstElement();
-
-    if (!d_ptr->m_Data.contains(pair))
-        return QMetaType::UnknownType;
-
-    const auto data = d_ptr->m_Data[pair];
-
-    if (!data.contains(role))
-        return QMetaType::UnknownType;
+    const auto e = d_ptr->entry(role, row, col);
 
-    return data[role].metaType;
+    return e ? e->m_MetaType : quint32(QMetaType::UnknownType);
 }
@@ -22,8 +22,11 @@ class QModelDataListDecoderPrivate;
  * that cannot be encoder. While it prints the QMetaType on stderr, it doesn't
  * export it. This, in turn, causes another problem where the QMap will be empty
  * if a single element fail to be deserialized. This little class implements a
- * serializable Qt type that mimics the QVariant decoder to be able to extract
- * the correct type.
+ * decoder for the QVariant headers to be able to extract the correct type.
+ *
+ * The payload is decoded lazily. Only the headers of the elements up to the
+ * requested one are read, the values of the common types are skipped and
+ * only decoded when data() asks for them.
  *
  * The QVariant data is encoded as (it is stable and documented):
  *
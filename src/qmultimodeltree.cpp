@@ -14,20 +14,39 @@ const T& qAsConst(const T& v)
 }
 #endif
 
+// The children don't have an InternalItem. Their internalId is the key of the
+// TreeNode of their parent, so no allocation is needed per row and index(),
+// parent() and mapToSource() are arithmetic. It doesn't contain the row, Qt
+// keeps the internal id when it moves the persistent indices around. The top
+// level items use the key of their model root node with the top_level bit.
+static const quintptr top_level = 1;
+
 struct InternalItem
 {
-    enum class Mode {
-        ROOT,
-        PROXY
-    };
-
     int                    m_Index;
-    Mode                   m_Mode;
+    int                    m_Slot; // key of the root TreeNode
     QAbstractItemModel*    m_pModel;
-    InternalItem*          m_pParent;
-    QVector<InternalItem*> m_lChildren;
     QString                m_Title;
     QVariant               m_UId, m_Bg, m_Fg, m_Deco;
+
+    // Between modelAboutToBeReset and modelReset, the children are removed
+    bool                   m_IsResetting;
+
+    // The TreeNode keys of the source indices with children
+    QHash<QModelIndex, int> m_hNodes;
+};
+
+/**
+ * A parent in the source model. Each model has a root node and the nested
+ * ones are only created once their children are accessed. They know their
+ * parent, so going up the tree doesn't need to walk the ancestors.
+ */
+struct TreeNode
+{
+    int                   m_Key;
+    int                   m_ParentKey; // -1 for the root node
+    InternalItem*         m_pItem;
+    QPersistentModelIndex m_Source;    // invalid for the root node
 };
 
 class QMultiModelTreePrivate : public QObject
@@ -38,15 +57,56 @@ public:
     QVector<InternalItem*> m_lRows;
     QHash<const QAbstractItemModel*, InternalItem*> m_hModels;
 
+    // The signals of a model usually come in bursts
+    mutable const QAbstractItemModel* m_pLastModel {Q_NULLPTR};
+    mutable InternalItem*             m_pLastItem  {Q_NULLPTR};
+
+    // Stable across the structural changes, null when free. They are created
+    // lazily by const methods.
+    mutable QVector<TreeNode*> m_lNodes;
+    mutable QVector<int>       m_lFreeKeys;
+
     bool m_HasIdRole {false};
     int m_IdRole {Qt::DisplayRole};
 
+    // The state of the structural changes in progress
+    bool                         m_IsMoving {false};
+    QModelIndexList              m_lLayoutProxy;
+    QList<QPersistentModelIndex> m_lLayoutSource;
+    QList<QPersistentModelIndex> m_lMovedProxy;
+
     QMultiModelTree* q_ptr;
 
+    // Helpers
+    static quintptr encode(int key, bool topLevel = false);
+    static bool isTopLevel(const QModelIndex& idx);
+    TreeNode* nodeForIndex(const QModelIndex& idx) const;
+    InternalItem* itemForIndex(const QModelIndex& idx) const;
+    InternalItem* itemForModel(const QAbstractItemModel* m) const;
+    TreeNode* nodeForSource(InternalItem* i, const QModelIndex& sourceParent) const;
+    int createNode(InternalItem* i, int parentKey, const QModelIndex& source) const;
+    void rekey(InternalItem* i, bool clear = false);
+    InternalItem* senderItem() const;
+    QModelIndex senderIndex() const;
+    QModelIndex mapParent(const QModelIndex& sourceParent) const;
+
 public Q_SLOTS:
+    void slotRowsAboutToBeInserted(const QModelIndex& parent, int first, int last);
     void slotRowsInserted(const QModelIndex& parent, int first, int last);
-    void slotDataChanged(const QModelIndex& tl, const QModelIndex& br);
-    void slotAddRows(const QModelIndex& parent, int first, int last, QAbstractItemModel* src);
+    void slotRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void slotRowsRemoved(const QModelIndex& parent, int first, int last);
+    void slotRowsAboutToBeMoved(const QModelIndex& parent, int first, int last,
+                                const QModelIndex& destination, int row);
+    void slotRowsMoved(const QModelIndex& parent, int first, int last,
+                       const QModelIndex& destination, int row);
+    void slotModelAboutToBeReset();
+    void slotModelReset();
+    void slotLayoutAboutToBeChanged(const QList<QPersistentModelIndex>& parents,
+                                    QAbstractItemModel::LayoutChangeHint hint);
+    void slotLayoutChanged(const QList<QPersistentModelIndex>& parents,
+                           QAbstractItemModel::LayoutChangeHint hint);
+    void slotDataChanged(const QModelIndex& tl, const QModelIndex& br,
+                         const QVector<int>& roles);
 };
 
 QMultiModelTree::QMultiModelTree(QObject* parent) : QAbstractItemModel(parent),
@@ -58,31 +118,133 @@ QMultiModelTree::QMultiModelTree(QObject* parent) : QAbstractItemModel(parent),
 QMultiModelTree::~QMultiModelTree()
 {
     d_ptr->m_hModels.clear();
-    while(!d_ptr->m_lRows.isEmpty()) {
-        while(!d_ptr->m_lRows.first()->m_lChildren.isEmpty())
-            delete d_ptr->m_lRows.first()->m_lChildren.first();
-        delete d_ptr->m_lRows.first();
-    }
+
+    for (auto n : qAsConst(d_ptr->m_lNodes))
+        delete n;
+
+    d_ptr->m_lNodes.clear();
+
+    for (auto i : qAsConst(d_ptr->m_lRows))
+        delete i;
+
+    d_ptr->m_lRows.clear();
 
     delete d_ptr;
 }
 
-QAbstractItemModel* QMultiModelTree::getModel(const QModelIndex& _idx) const
+quintptr QMultiModelTreePrivate::encode(int key, bool topLevel)
+{
+    return (quintptr(key + 1) << 1) | (topLevel ? top_level : 0);
+}
+
+bool QMultiModelTreePrivate::isTopLevel(const QModelIndex& idx)
+{
+    return idx.internalId() & top_level;
+}
+
+/// Null when the key is out of range or its node was freed
+TreeNode* QMultiModelTreePrivate::nodeForIndex(const QModelIndex& idx) const
+{
+    const int key = int(idx.internalId() >> 1) - 1;
+
+    if (key < 0 || key >= m_lNodes.size())
+        return Q_NULLPTR;
+
+    return m_lNodes[key];
+}
+
+InternalItem* QMultiModelTreePrivate::itemForIndex(const QModelIndex& idx) const
 {
-    auto idx = _idx;
+    const auto n = nodeForIndex(idx);
 
-    if (idx.parent().isValid())
-        idx = idx.parent();
+    return n ? n->m_pItem : Q_NULLPTR;
+}
+
+InternalItem* QMultiModelTreePrivate::itemForModel(const QAbstractItemModel* m) const
+{
+    if (m == m_pLastModel)
+        return m_pLastItem;
 
-    if ((!idx.isValid()) || idx.model() != this || idx.parent().isValid())
+    const auto it = m_hModels.constFind(m);
+
+    if (it == m_hModels.constEnd())
         return Q_NULLPTR;
 
-    const auto i = static_cast<InternalItem*>(idx.internalPointer());
+    m_pLastModel = m;
+    m_pLastItem  = *it;
+
+    return *it;
+}
 
-    Q_ASSERT(!i->m_pParent);
-    Q_ASSERT(i->m_pModel);
+int QMultiModelTreePrivate::createNode(InternalItem* i, int parentKey, const QModelIndex& source) const
+{
+    int key;
 
-    return i->m_pModel;
+    if (!m_lFreeKeys.isEmpty())
+        key = m_lFreeKeys.takeLast();
+    else {
+        key = m_lNodes.size();
+        m_lNodes << Q_NULLPTR;
+    }
+
+    m_lNodes[key] = new TreeNode { key, parentKey, i, source };
+
+    if (source.isValid())
+        i->m_hNodes[source] = key;
+
+    return key;
+}
+
+TreeNode* QMultiModelTreePrivate::nodeForSource(InternalItem* i, const QModelIndex& sourceParent) const
+{
+    if (!sourceParent.isValid())
+        return m_lNodes[i->m_Slot];
+
+    const auto it = i->m_hNodes.constFind(sourceParent);
+
+    if (it != i->m_hNodes.constEnd())
+        return m_lNodes[*it];
+
+    // Only the first access walks up the (not yet cached) ancestors
+    const auto parent = nodeForSource(i, sourceParent.parent());
+
+    return m_lNodes[createNode(i, parent->m_Key, sourceParent)];
+}
+
+/**
+ * The source indices of the nodes change with the source structure. Rebuild
+ * the lookup table and drop the nodes which are gone. If `clear` is set,
+ * drop all nodes except the root.
+ */
+void QMultiModelTreePrivate::rekey(InternalItem* i, bool clear)
+{
+    i->m_hNodes.clear();
+
+    for (int k = 0; k < m_lNodes.size(); k++) {
+        auto n = m_lNodes[k];
+
+        if ((!n) || n->m_pItem != i || n->m_ParentKey == -1)
+            continue;
+
+        if (clear || !n->m_Source.isValid()) {
+            delete n;
+            m_lNodes[k] = Q_NULLPTR;
+            m_lFreeKeys << k;
+            continue;
+        }
+
+        i->m_hNodes[n->m_Source] = k;
+    }
+}
+
+QAbstractItemModel* QMultiModelTree::getModel(const QModelIndex& idx) const
+{
+    if ((!idx.isValid()) || idx.model() != this)
+        return Q_NULLPTR;
+
+    const auto i = d_ptr->itemForIndex(idx);
+
+    return i ? i->m_pModel : Q_NULLPTR;
 }
 
 QVariant QMultiModelTree::data(const QModelIndex& idx, int role) const
@@ -90,9 +252,12 @@ QVariant QMultiModelTree::data(const QModelIndex& idx, int role) const
     if (!idx.isValid())
         return {};
 
-    const auto i = static_cast<InternalItem*>(idx.internalPointer());
+    const auto i = d_ptr->itemForIndex(idx);
 
-    if (i->m_Mode == InternalItem::Mode::PROXY)
+    if (!i)
+        return {};
+
+    if (!d_ptr->isTopLevel(idx))
         return i->m_pModel->data(mapToSource(idx), role);
 
     if (d_ptr->m_HasIdRole && d_ptr->m_IdRole == role)
@@ -118,45 +283,45 @@ bool QMultiModelTree::setData(const QModelIndex &index, const QVariant &value, i
     if (!index.isValid())
         return {};
 
-    auto i = static_cast<InternalItem*>(index.internalPointer());
+    auto i = d_ptr->itemForIndex(index);
 
-    switch(i->m_Mode) {
-        case InternalItem::Mode::PROXY:
-            return i->m_pModel->setData(mapToSource(index), value, role);
-        case InternalItem::Mode::ROOT:
-            if (d_ptr->m_HasIdRole && d_ptr->m_IdRole == role) {
-                i->m_UId = value;
-                Q_EMIT dataChanged(index, index);
-                return true;
-            }
-            switch(role) {
-                case Qt::BackgroundRole:
-                    i->m_Bg = value;
-                    Q_EMIT dataChanged(index, index);
-                    return true;
-                case Qt::ForegroundRole:
-                    i->m_Fg = value;
-                    Q_EMIT dataChanged(index, index);
-                    return true;
-                case Qt::DecorationRole:
-                    i->m_Deco = value;
-                    Q_EMIT dataChanged(index, index);
-                    return true;
-                case Qt::DisplayRole:
-                case Qt::EditRole: {
-                    const auto oldT = i->m_Title;
-                    const auto newT = value.toString();
-                    i->m_Title = newT;
-                    Q_EMIT dataChanged(index, index);
-                    if (newT != oldT) {
-                        Q_EMIT modelRenamed(i->m_pModel, newT, oldT);
-                        Q_EMIT modelRenamed(index, newT, oldT);
-                    }
-                    return true;
-                }
-                break;
+    if (!i)
+        return false;
+
+    if (!d_ptr->isTopLevel(index))
+        return i->m_pModel->setData(mapToSource(index), value, role);
+
+    if (d_ptr->m_HasIdRole && d_ptr->m_IdRole == role) {
+        i->m_UId = value;
+        Q_EMIT dataChanged(index, index, {role});
+        return true;
+    }
+
+    switch(role) {
+        case Qt::BackgroundRole:
+            i->m_Bg = value;
+            Q_EMIT dataChanged(index, index, {Qt::BackgroundRole});
+            return true;
+        case Qt::ForegroundRole:
+            i->m_Fg = value;
+            Q_EMIT dataChanged(index, index, {Qt::ForegroundRole});
+            return true;
+        case Qt::DecorationRole:
+            i->m_Deco = value;
+            Q_EMIT dataChanged(index, index, {Qt::DecorationRole});
+            return true;
+        case Qt::DisplayRole:
+        case Qt::EditRole: {
+            const auto oldT = i->m_Title;
+            const auto newT = value.toString();
+            i->m_Title = newT;
+            Q_EMIT dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
+            if (newT != oldT) {
+                Q_EMIT modelRenamed(i->m_pModel, newT, oldT);
+                Q_EMIT modelRenamed(index, newT, oldT);
             }
-            break;
+            return true;
+        }
     };
 
     return false;
@@ -167,12 +332,15 @@ int QMultiModelTree::rowCount(const QModelIndex& parent) const
     if (!parent.isValid())
         return d_ptr->m_lRows.size();
 
-    const auto i = static_cast<InternalItem*>(parent.internalPointer());
+    const auto i = d_ptr->itemForIndex(parent);
 
-    if (i->m_Mode == InternalItem::Mode::PROXY)
+    if ((!i) || i->m_IsResetting)
         return 0;
 
-    return i->m_pModel->rowCount();
+    if (d_ptr->isTopLevel(parent))
+        return i->m_pModel->rowCount();
+
+    return i->m_pModel->rowCount(mapToSource(parent));
 }
 
 int QMultiModelTree::columnCount(const QModelIndex& parent) const
@@ -183,21 +351,41 @@ int QMultiModelTree::columnCount(const QModelIndex& parent) const
 
 QModelIndex QMultiModelTree::index(int row, int column, const QModelIndex& parent) const
 {
-    if (
-        (!parent.isValid())
-        && row >= 0
-        && row < d_ptr->m_lRows.size()
-        && column == 0
-    )
-        return createIndex(row, column, d_ptr->m_lRows[row]);
+    if (row < 0 || column)
+        return {};
+
+    if (!parent.isValid()) {
+        if (row >= d_ptr->m_lRows.size())
+            return {};
+
+        return createIndex(row, 0, d_ptr->encode(d_ptr->m_lRows[row]->m_Slot, true));
+    }
 
-    if ((!parent.isValid()) || parent.model() != this)
+    if (parent.model() != this)
         return {};
 
+    const auto i = d_ptr->itemForIndex(parent);
 
-    const auto i = static_cast<InternalItem*>(parent.internalPointer());
+    if ((!i) || i->m_IsResetting)
+        return {};
+
+    if (d_ptr->isTopLevel(parent)) {
+        if (row >= i->m_pModel->rowCount())
+            return {};
+
+        return createIndex(row, 0, d_ptr->encode(i->m_Slot));
+    }
+
+    // Nested, the node of `parent` is created when its children are first
+    // accessed
+    const auto srcParent = mapToSource(parent);
+
+    if (row >= i->m_pModel->rowCount(srcParent))
+        return {};
+
+    const auto n = d_ptr->nodeForSource(i, srcParent);
 
-    return mapFromSource(i->m_pModel->index(row, column));
+    return createIndex(row, 0, d_ptr->encode(n->m_Key));
 }
 
 Qt::ItemFlags QMultiModelTree::flags(const QModelIndex &idx) const
@@ -209,28 +397,35 @@ Qt::ItemFlags QMultiModelTree::flags(const QModelIndex &idx) const
 
 QModelIndex QMultiModelTree::parent(const QModelIndex& idx) const
 {
-    if (!idx.isValid())
+    if ((!idx.isValid()) || d_ptr->isTopLevel(idx))
         return {};
 
-    const auto i = static_cast<InternalItem*>(idx.internalPointer());
+    const auto n = d_ptr->nodeForIndex(idx);
 
-    if (i->m_Mode == InternalItem::Mode::ROOT)
+    if (!n)
         return {};
 
-    return createIndex(i->m_pParent->m_Index, 0, i->m_pParent);
+    if (n->m_ParentKey == -1)
+        return createIndex(n->m_pItem->m_Index, 0, d_ptr->encode(n->m_Key, true));
+
+    const int row = n->m_Source.row();
+
+    return createIndex(row, 0, d_ptr->encode(n->m_ParentKey));
 }
 
 QModelIndex QMultiModelTree::mapFromSource(const QModelIndex& sourceIndex) const
 {
-    if ((!sourceIndex.isValid()) || sourceIndex.parent().isValid() || sourceIndex.column())
+    if ((!sourceIndex.isValid()) || sourceIndex.column())
         return {};
 
-    const auto i = d_ptr->m_hModels[sourceIndex.model()];
+    const auto i = d_ptr->itemForModel(sourceIndex.model());
 
-    if ((!i) || sourceIndex.row() >= i->m_lChildren.size())
+    if ((!i) || i->m_IsResetting)
         return {};
 
-    return createIndex(sourceIndex.row(), 0, i->m_lChildren[sourceIndex.row()]);
+    const auto n = d_ptr->nodeForSource(i, sourceIndex.parent());
+
+    return createIndex(sourceIndex.row(), 0, d_ptr->encode(n->m_Key));
 }
 
 QModelIndex QMultiModelTree::mapToSource(const QModelIndex& proxyIndex) const
@@ -238,12 +433,25 @@ QModelIndex QMultiModelTree::mapToSource(const QModelIndex& proxyIndex) const
     if ((!proxyIndex.isValid()) || proxyIndex.model() != this)
         return {};
 
-    if (!proxyIndex.parent().isValid())
+    return mapToSource(proxyIndex.row(), proxyIndex.column(), proxyIndex.internalId());
+}
+
+QModelIndex QMultiModelTree::mapToSource(int row, int column, quintptr internalId) const
+{
+    if (internalId & top_level)
         return {};
 
-    const auto i = static_cast<InternalItem*>(proxyIndex.internalPointer());
+    const int key = int(internalId >> 1) - 1;
 
-    return i->m_pModel->index(proxyIndex.row(), proxyIndex.column());
+    if (key < 0 || key >= d_ptr->m_lNodes.size())
+        return {};
+
+    const auto n = d_ptr->m_lNodes[key];
+
+    if ((!n) || n->m_pItem->m_IsResetting)
+        return {};
+
+    return n->m_pItem->m_pModel->index(row, column, n->m_Source);
 }
 
 bool QMultiModelTree::removeRows(int row, int count, const QModelIndex &parent)
@@ -251,33 +459,37 @@ bool QMultiModelTree::removeRows(int row, int count, const QModelIndex &parent)
     if (row < 0 || count < 1)
         return false;
 
-    auto idx = parent;
-
-    while (idx.parent().isValid())
-        idx = idx.parent();
+    // The source notifies the removal itself
+    if (parent.isValid() && parent.model() == this) {
+        const auto i = d_ptr->itemForIndex(parent);
 
-    if (idx.isValid() && !idx.parent().isValid()) {
-        const auto i = static_cast<InternalItem*>(idx.internalPointer());
-        if (i->m_pModel->removeRows(row, count, mapToSource(parent))) {
-            beginRemoveRows(parent, row, row + count - 1);
-            endRemoveRows();
-            return true;
-        }
-        //FIXME update the m_Index
+        return i && i->m_pModel->removeRows(row, count, mapToSource(parent));
     }
-    else if (!parent.isValid() && row + count <= d_ptr->m_lRows.size()) {
+
+    if ((!parent.isValid()) && row + count <= d_ptr->m_lRows.size()) {
 
         beginRemoveRows(parent, row, row + count - 1);
+            d_ptr->m_pLastModel = Q_NULLPTR;
+            d_ptr->m_pLastItem  = Q_NULLPTR;
+
             for(int i = row; i < row+count; i++) {
                 auto item = d_ptr->m_lRows[i];
                 d_ptr->m_hModels.remove(item->m_pModel);
 
+                disconnect(item->m_pModel, Q_NULLPTR, d_ptr, Q_NULLPTR);
+
+                d_ptr->rekey(item, true);
+
+                delete d_ptr->m_lNodes[item->m_Slot];
+                d_ptr->m_lNodes[item->m_Slot] = Q_NULLPTR;
+                d_ptr->m_lFreeKeys << item->m_Slot;
+
                 delete item;
             }
 
             d_ptr->m_lRows.remove(row, count);
 
-            for (int i = row+count-1; i < rowCount(); i++)
+            for (int i = row; i < rowCount(); i++)
                 d_ptr->m_lRows[i]->m_Index = i;
 
         endRemoveRows();
@@ -288,74 +500,254 @@ bool QMultiModelTree::removeRows(int row, int count, const QModelIndex &parent)
     return false;
 }
 
-void QMultiModelTreePrivate::slotAddRows(const QModelIndex& parent, int first, int last, QAbstractItemModel* src)
+InternalItem* QMultiModelTreePrivate::senderItem() const
+{
+    const auto i = itemForModel(static_cast<QAbstractItemModel*>(QObject::sender()));
+    Q_ASSERT(i);
+
+    return i;
+}
+
+QModelIndex QMultiModelTreePrivate::senderIndex() const
 {
-    if (parent.isValid()) return;
+    return q_ptr->index(senderItem()->m_Index, 0);
+}
 
-    auto p = m_hModels[src];
-    Q_ASSERT(p);
+QModelIndex QMultiModelTreePrivate::mapParent(const QModelIndex& sourceParent) const
+{
+    return sourceParent.isValid() ?
+        q_ptr->mapFromSource(sourceParent) : senderIndex();
+}
 
-    const auto localParent = q_ptr->index(p->m_Index, 0);
+// The source rows are already updated when the "done" signals are received,
+// the node table has to be fixed before forwarding them.
 
-    q_ptr->beginInsertRows(localParent, first, last);
-    for (int i = first; i <= last; i++) {
-        p->m_lChildren << new InternalItem {
-            p->m_lChildren.size(),
-            InternalItem::Mode::PROXY,
-            src,
-            p,
-            {},
-            QStringLiteral("N/A"),
-            {}, {}, {}, {}
-        };
-    }
-    q_ptr->endInsertRows();
+void QMultiModelTreePrivate::slotRowsAboutToBeInserted(const QModelIndex& parent, int first, int last)
+{
+    q_ptr->beginInsertRows(mapParent(parent), first, last);
 }
 
 void QMultiModelTreePrivate::slotRowsInserted(const QModelIndex& parent, int first, int last)
 {
-    const auto model = qobject_cast<QAbstractItemModel*>(QObject::sender());
-    Q_ASSERT(model);
+    Q_UNUSED(first)
+    Q_UNUSED(last)
+
+    if (!senderItem()->m_hNodes.isEmpty())
+        rekey(senderItem());
 
-    slotAddRows(parent, first, last, model);
+    q_ptr->endInsertRows();
 }
 
-void QMultiModelTreePrivate::slotDataChanged(const QModelIndex& tl, const QModelIndex& br)
+void QMultiModelTreePrivate::slotRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
 {
-    if (tl == br && !tl.parent().isValid()) {
-        const auto i = q_ptr->mapFromSource(tl);
+    q_ptr->beginRemoveRows(mapParent(parent), first, last);
+}
+
+void QMultiModelTreePrivate::slotRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent)
+    Q_UNUSED(first)
+    Q_UNUSED(last)
+
+    if (!senderItem()->m_hNodes.isEmpty())
+        rekey(senderItem());
+
+    q_ptr->endRemoveRows();
+}
+
+void QMultiModelTreePrivate::slotRowsAboutToBeMoved(const QModelIndex& parent, int first, int last, const QModelIndex& destination, int row)
+{
+    const auto proxyParent = mapParent(parent);
+
+    m_IsMoving = q_ptr->beginMoveRows(
+        proxyParent, first, last, mapParent(destination), row
+    );
 
-        Q_ASSERT((!tl.isValid()) || i.isValid());
+    m_lMovedProxy.clear();
+    m_lLayoutSource.clear();
 
-        Q_EMIT q_ptr->dataChanged(i, i);
+    // The ids contain the parent node, so Qt can't update the persistent
+    // indices moved to another parent by itself
+    if ((!m_IsMoving) || parent == destination)
+        return;
+
+    const auto persistent = q_ptr->persistentIndexList();
+
+    for (const auto& p : persistent) {
+        if (p.row() < first || p.row() > last || p.parent() != proxyParent)
+            continue;
+
+        m_lMovedProxy   << p;
+        m_lLayoutSource << QPersistentModelIndex(q_ptr->mapToSource(p));
     }
-    else {
-        Q_EMIT q_ptr->dataChanged(q_ptr->mapFromSource(tl), q_ptr->mapFromSource(br));
+}
+
+void QMultiModelTreePrivate::slotRowsMoved(const QModelIndex& parent, int first, int last, const QModelIndex& destination, int row)
+{
+    Q_UNUSED(parent)
+    Q_UNUSED(first)
+    Q_UNUSED(last)
+    Q_UNUSED(destination)
+    Q_UNUSED(row)
+
+    if (!senderItem()->m_hNodes.isEmpty())
+        rekey(senderItem());
+
+    if (!m_IsMoving) return;
+
+    m_IsMoving = false;
+    q_ptr->endMoveRows();
+
+    if (m_lMovedProxy.isEmpty())
+        return;
+
+    // Qt moved their rows and kept the old parent, fix the ids
+    QModelIndexList from, to;
+
+    for (int k = 0; k < m_lMovedProxy.size(); k++) {
+        from << m_lMovedProxy[k];
+        to   << q_ptr->mapFromSource(m_lLayoutSource[k]);
     }
+
+    m_lMovedProxy.clear();
+    m_lLayoutSource.clear();
+
+    q_ptr->changePersistentIndexList(from, to);
+}
+
+// Only the children of that model are removed and inserted again, the rest of
+// the tree (and everything built on top of it) is kept.
+void QMultiModelTreePrivate::slotModelAboutToBeReset()
+{
+    const auto i  = senderItem();
+    const int  rc = i->m_pModel->rowCount();
+
+    if (rc)
+        q_ptr->beginRemoveRows(senderIndex(), 0, rc - 1);
+
+    i->m_IsResetting = true;
+    rekey(i, true);
+
+    if (rc)
+        q_ptr->endRemoveRows();
+}
+
+void QMultiModelTreePrivate::slotModelReset()
+{
+    const auto i  = senderItem();
+    const int  rc = i->m_pModel->rowCount();
+
+    if (rc)
+        q_ptr->beginInsertRows(senderIndex(), 0, rc - 1);
+
+    i->m_IsResetting = false;
+
+    if (rc)
+        q_ptr->endInsertRows();
+}
+
+void QMultiModelTreePrivate::slotLayoutAboutToBeChanged(const QList<QPersistentModelIndex>& parents, QAbstractItemModel::LayoutChangeHint hint)
+{
+    Q_UNUSED(parents)
+
+    const auto i   = senderItem();
+    const auto idx = senderIndex();
+
+    Q_EMIT q_ptr->layoutAboutToBeChanged({QPersistentModelIndex(idx)}, hint);
+
+    m_lLayoutProxy.clear();
+    m_lLayoutSource.clear();
+
+    // Keep track of where the persistent children go
+    const auto persistent = q_ptr->persistentIndexList();
+
+    for (const auto& p : persistent) {
+        if (isTopLevel(p) || itemForIndex(p) != i)
+            continue;
+
+        m_lLayoutProxy  << p;
+        m_lLayoutSource << QPersistentModelIndex(q_ptr->mapToSource(p));
+    }
+}
+
+void QMultiModelTreePrivate::slotLayoutChanged(const QList<QPersistentModelIndex>& parents, QAbstractItemModel::LayoutChangeHint hint)
+{
+    Q_UNUSED(parents)
+
+    rekey(senderItem());
+
+    QModelIndexList newList;
+    newList.reserve(m_lLayoutSource.size());
+
+    for (const auto& src : qAsConst(m_lLayoutSource))
+        newList << q_ptr->mapFromSource(src);
+
+    q_ptr->changePersistentIndexList(m_lLayoutProxy, newList);
+
+    m_lLayoutProxy.clear();
+    m_lLayoutSource.clear();
+
+    Q_EMIT q_ptr->layoutChanged({QPersistentModelIndex(senderIndex())}, hint);
+}
+
+void QMultiModelTreePrivate::slotDataChanged(const QModelIndex& tl, const QModelIndex& br, const QVector<int>& roles)
+{
+    if ((!tl.isValid()) || tl.column())
+        return;
+
+    const auto i = q_ptr->mapFromSource(tl);
+
+    if (!i.isValid())
+        return;
+
+    // Both corners have the same parent, so the same node. Only the first
+    // column is exposed.
+    const auto b = tl.row() == br.row() ? i : q_ptr->createIndex(
+        br.row(), 0, i.internalId()
+    );
+
+    Q_EMIT q_ptr->dataChanged(i, b, roles);
 }
 
 QModelIndex QMultiModelTree::appendModel(QAbstractItemModel* model, const QVariant& id)
 {
-    if ((!model) || d_ptr->m_hModels[model]) return {};
+    if ((!model) || d_ptr->m_hModels.contains(model)) return {};
 
+    // The children are implicit, they are inserted with their parent
     beginInsertRows({}, d_ptr->m_lRows.size(), d_ptr->m_lRows.size());
-    d_ptr->m_hModels[model] = new InternalItem {
+    auto item = new InternalItem {
         d_ptr->m_lRows.size(),
-        InternalItem::Mode::ROOT,
+        -1,
         model,
-        Q_NULLPTR,
-        {},
         id.canConvert<QString>() ? id.toString() : model->objectName(),
         id, {}, {}, {}
     };
-    d_ptr->m_lRows << d_ptr->m_hModels[model];
-    endInsertRows();
+    item->m_Slot = d_ptr->createNode(item, -1, {});
 
-    d_ptr->slotAddRows({}, 0, model->rowCount(), model);
+    d_ptr->m_hModels[model]  = item;
+    d_ptr->m_lRows << item;
+    endInsertRows();
 
-    //TODO connect to the model row moved/removed/reset
+    connect(model, &QAbstractItemModel::rowsAboutToBeInserted,
+        d_ptr, &QMultiModelTreePrivate::slotRowsAboutToBeInserted);
     connect(model, &QAbstractItemModel::rowsInserted,
         d_ptr, &QMultiModelTreePrivate::slotRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved,
+        d_ptr, &QMultiModelTreePrivate::slotRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::rowsRemoved,
+        d_ptr, &QMultiModelTreePrivate::slotRowsRemoved);
+    connect(model, &QAbstractItemModel::rowsAboutToBeMoved,
+        d_ptr, &QMultiModelTreePrivate::slotRowsAboutToBeMoved);
+    connect(model, &QAbstractItemModel::rowsMoved,
+        d_ptr, &QMultiModelTreePrivate::slotRowsMoved);
+    connect(model, &QAbstractItemModel::modelAboutToBeReset,
+        d_ptr, &QMultiModelTreePrivate::slotModelAboutToBeReset);
+    connect(model, &QAbstractItemModel::modelReset,
+        d_ptr, &QMultiModelTreePrivate::slotModelReset);
+    connect(model, &QAbstractItemModel::layoutAboutToBeChanged,
+        d_ptr, &QMultiModelTreePrivate::slotLayoutAboutToBeChanged);
+    connect(model, &QAbstractItemModel::layoutChanged,
+        d_ptr, &QMultiModelTreePrivate::slotLayoutChanged);
     connect(model, &QAbstractItemModel::dataChanged,
         d_ptr, &QMultiModelTreePrivate::slotDataChanged);
 
@@ -369,7 +761,10 @@ bool QMultiModelTree::canDropMimeData(const QMimeData *data, Qt::DropAction acti
     if (!idx.isValid())
         return false;
 
-    const auto i = static_cast<InternalItem*>(idx.internalPointer());
+    const auto i = d_ptr->itemForIndex(idx);
+
+    if (!i)
+        return false;
 
     auto srcIdx = mapToSource(idx);
 
@@ -383,7 +778,10 @@ bool QMultiModelTree::dropMimeData(const QMimeData *data, Qt::DropAction action,
     if (!idx.isValid())
         return false;
 
-    const auto i = static_cast<InternalItem*>(idx.internalPointer());
+    const auto i = d_ptr->itemForIndex(idx);
+
+    if (!i)
+        return false;
 
     auto srcIdx = mapToSource(idx);
 
@@ -11,8 +11,9 @@ class QMultiModelTreePrivate;
  * The use case for this is either views like side panels or as a node in a
  * longer proxy model chain.
  * 
- * Note that this code currently doesn't tree models as children. If anybody
- * has a solution that's both fast and reliable, please tell.
+ * Tree models are supported as children. Each source parent gets a node
+ * knowing its own parent once its children are first accessed, so parent()
+ * and mapFromSource() don't have to walk up the source tree.
  */
 class QMultiModelTree : public QAbstractItemModel
 {
@@ -36,6 +37,13 @@ public:
     virtual QModelIndex parent(const QModelIndex& idx) const override;
     virtual QModelIndex mapFromSource(const QModelIndex& sourceIndex) const;
     virtual QModelIndex mapToSource(const QModelIndex& proxyIndex) const;
+
+    /**
+     * The identity proxies on top of this model keep the row, column and
+     * internal id. This resolves their indices to the source in one hop
+     * instead of one per proxy. The top level indices have no source.
+     */
+    QModelIndex mapToSource(int row, int column, quintptr internalId) const;
     virtual bool canDropMimeData(const QMimeData *data, Qt::DropAction action,
                 int row, int column, const QModelIndex &parent) const override;
     virtual bool dropMimeData(const QMimeData *data, Qt::DropAction action,
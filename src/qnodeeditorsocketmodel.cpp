@@ -1,17 +1,26 @@
 #include "qnodeeditorsocketmodel.h"
 
 #include "graphicsnode.hpp"
+#include "graphicsnode_p.h"
+#include "graphicsnodeexport_p.h"
+#include "graphicsedgerouter_p.h"
 #include "graphicsnodescene.hpp"
 #include "graphicsbezieredge.hpp"
 #include "graphicsbezieredge_p.h"
 
 #include "qreactiveproxymodel.h"
-
-#include "qmodeldatalistdecoder.h"
+#include "qmultimodeltree.h"
 
 #include <QtCore/QDebug>
+#include <QtCore/QHash>
 #include <QtCore/QMimeData>
 #include <QtCore/QSortFilterProxyModel>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+#include <QtWidgets/QGraphicsPathItem>
+
+#include <algorithm>
+#include <cmath>
 
 #include "qobjectmodel.h" //TODO remove
 
@@ -24,6 +33,75 @@ const T& qAsConst(const T& v)
 }
 #endif
 
+// Edge of a node grid cell, in scene units. A few nodes wide, so a scroll
+// only touches the cells along the borders of the view
+static const qreal node_cell = 256.0;
+
+static inline int nodeCellCoord(qreal v)
+{
+    return int(std::floor(v / node_cell));
+}
+
+static inline quint64 nodeCellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint64(quint32(y));
+}
+
+// The cells covered by a scene rect, inclusive
+static inline QRect nodeCells(const QRectF& r)
+{
+    return QRect(
+        QPoint(nodeCellCoord(r.left ()), nodeCellCoord(r.top   ())),
+        QPoint(nodeCellCoord(r.right()), nodeCellCoord(r.bottom()))
+    );
+}
+
+// Move an item from the `current` cells of a grid to the new ones
+template<typename T>
+static void moveInGrid(QHash<quint64, QVector<T*>>& grid, T* item, QRect& current, const QRect& cells)
+{
+    if (cells == current)
+        return;
+
+    for (int x = current.left(); x <= current.right(); x++) {
+        for (int y = current.top(); y <= current.bottom(); y++) {
+            const auto cell = grid.find(nodeCellKey(x, y));
+
+            if (cell == grid.end())
+                continue;
+
+            cell->removeOne(item);
+
+            if (cell->isEmpty())
+                grid.erase(cell);
+        }
+    }
+
+    for (int x = cells.left(); x <= cells.right(); x++)
+        for (int y = cells.top(); y <= cells.bottom(); y++)
+            grid[nodeCellKey(x, y)] << item;
+
+    current = cells;
+}
+
+template<typename T>
+static void collectFromGrid(const QHash<quint64, QVector<T*>>& grid, const QRectF& area, QSet<T*>& items)
+{
+    const QRect cells = nodeCells(area);
+
+    for (int x = cells.left(); x <= cells.right(); x++) {
+        for (int y = cells.top(); y <= cells.bottom(); y++) {
+            const auto cell = grid.constFind(nodeCellKey(x, y));
+
+            if (cell == grid.constEnd())
+                continue;
+
+            for (auto item : *cell)
+                items.insert(item);
+        }
+    }
+}
+
 class QNodeEdgeFilterProxy;
 
 struct EdgeWrapper;
@@ -35,14 +113,11 @@ struct NodeWrapper final
 
     GraphicsNode m_Node;
 
-    // Keep aligned with the source row
-    QVector<int> m_lSourcesFromSrc {};
-    QVector<int> m_lSinksFromSrc {};
-
-    QVector<int> m_lSourcesToSrc {};
-    QVector<int> m_lSinksToSrc {};
+    // Position of the socket indices in the lists, rebuilt by remapSockets
+    QHash<QModelIndex, int> m_hSourcesFromSrc {};
+    QHash<QModelIndex, int> m_hSinksFromSrc {};
 
-    // Keep aligned with the node row
+    // Depth first order of the rows below the node, nested rows included
     QVector<SocketWrapper*> m_lSources {};
     QVector<SocketWrapper*> m_lSinks {};
 
@@ -50,6 +125,9 @@ struct NodeWrapper final
     mutable QNodeEdgeFilterProxy *m_pSinkProxy {Q_NULLPTR};
 
     QRectF m_SceneRect;
+
+    // Where the node is in the grid, null when it isn't
+    QRect m_Cells;
 };
 
 struct SocketWrapper final
@@ -107,6 +185,9 @@ struct EdgeWrapper final
     bool               m_IsShown {  false  };
     int                m_EdgeId  {s_CurId++};
 
+    // Where the route is in the grid, null when there is none
+    QRect              m_RouteCells;
+
     static int s_CurId;
 };
 
@@ -127,12 +208,44 @@ public:
     GraphicsNodeScene*    m_pScene;
     State                 m_State {State::NORMAL};
     quint32               m_CurrentTypeId {QMetaType::UnknownType};
+    NodeItemPool          m_ItemPool;
+    bool                  m_IsVirtualized {true};
+    bool                  m_IsDetailed    {true};
+    QRectF                m_RealizedArea;
+    EdgeRouter*           m_pRouter {nullptr};
+    QSet<int>             m_hDirtyRoutes;
+    QTimer                m_RouteTimer;
+    quint64               m_RouteSerial {0};
+    int                   m_BatchDepth  {0};
+    bool                  m_IsFused     {false};
+    QMultiModelTree*      m_pFusedTree  {nullptr};
+
+    // Spatial index of the nodes, so the realized area changes only look
+    // at the nodes around it
+    QHash<quint64, QVector<NodeWrapper*>> m_hNodeCells;
+
+    // Same for the orthogonal routes, so moving a node only looks at the
+    // edges passing around it
+    QHash<quint64, QVector<EdgeWrapper*>> m_hRouteCells;
+
+    // Nodes kept realized outside of the area (selected)
+    QSet<NodeWrapper*> m_hPinned;
 
     // helper
     GraphicsNode* insertNode(int idx);
+    void updateRealization(NodeWrapper* nw);
+    void updateCells(NodeWrapper* nw, bool remove = false);
+    void nodesIn(const QRectF& area, QSet<NodeWrapper*>& nodes) const;
+    void invalidateRoutes(NodeWrapper* nw, const QRectF& oldRect);
+    void scheduleRoute(EdgeWrapper* e);
+    void applyRoutes(const QVector<EdgeRoute>& routes);
     NodeWrapper*  getNode(const QModelIndex& idx, bool r = false) const;
+    void updateFusion();
 
     void insertSockets(const QModelIndex& parent, int first, int last);
+    void createSockets(NodeWrapper* nodew, const QModelIndex& idx);
+    void remapSockets(NodeWrapper* nw);
+    void remapNodes(int first);
     void updateSockets(const QModelIndex& parent, int first, int last);
 
     GraphicsDirectedEdge* initiateConnectionFromSource(
@@ -143,7 +256,7 @@ public:
 
     // Use a template so the compiler can safely inline the result
     template<
-        QVector<int> NodeWrapper::* SM,
+        QHash<QModelIndex, int> NodeWrapper::* SM,
         QVector<SocketWrapper*> NodeWrapper::* S,
         SocketWrapper* EdgeWrapper::* E
     >
@@ -158,7 +271,16 @@ public Q_SLOTS:
     void slotRowsInserted       (const QModelIndex& parent, int first, int last);
     void slotConnectionsInserted(const QModelIndex& parent, int first, int last);
     void slotConnectionsChanged (const QModelIndex& tl, const QModelIndex& br  );
+    void slotDataChanged        (const QModelIndex& tl, const QModelIndex& br,
+                                 const QVector<int>& roles                     );
     void slotAboutRemoveItem    (const QModelIndex &parent, int first, int last);
+    void slotRowsRemoved        (const QModelIndex& parent, int first, int last);
+    void slotAboutMoveItem      (const QModelIndex& parent, int first, int last,
+                                 const QModelIndex& destination, int row       );
+    void slotRowsMoved          (const QModelIndex& parent, int first, int last,
+                                 const QModelIndex& destination, int row       );
+    void slotLayoutChanged      (const QList<QPersistentModelIndex>& parents   );
+    void slotFlushRoutes        (                                              );
     void exitDraggingMode();
 };
 
@@ -187,6 +309,25 @@ QNodeEditorSocketModel::QNodeEditorSocketModel( QReactiveProxyModel* rmodel, Gra
     connect(this, &QAbstractItemModel::rowsAboutToBeRemoved,
         d_ptr, &QNodeEditorSocketModelPrivate::slotAboutRemoveItem);
 
+    connect(this, &QAbstractItemModel::rowsRemoved,
+        d_ptr, &QNodeEditorSocketModelPrivate::slotRowsRemoved);
+
+    connect(this, &QAbstractItemModel::rowsAboutToBeMoved,
+        d_ptr, &QNodeEditorSocketModelPrivate::slotAboutMoveItem);
+
+    connect(this, &QAbstractItemModel::rowsMoved,
+        d_ptr, &QNodeEditorSocketModelPrivate::slotRowsMoved);
+
+    connect(this, &QAbstractItemModel::layoutChanged,
+        d_ptr, &QNodeEditorSocketModelPrivate::slotLayoutChanged);
+
+    connect(this, &QAbstractItemModel::dataChanged,
+        d_ptr, &QNodeEditorSocketModelPrivate::slotDataChanged);
+
+    // The reactive model source is replaced with a reset
+    connect(this, &QAbstractItemModel::modelReset,
+        d_ptr, &QNodeEditorSocketModelPrivate::updateFusion);
+
     connect(&d_ptr->m_EdgeModel, &QAbstractItemModel::rowsInserted,
         d_ptr, &QNodeEditorSocketModelPrivate::slotConnectionsInserted);
 
@@ -194,11 +335,22 @@ QNodeEditorSocketModel::QNodeEditorSocketModel( QReactiveProxyModel* rmodel, Gra
         d_ptr, &QNodeEditorSocketModelPrivate::slotConnectionsChanged);
 
 
+    // Route on the next event loop iteration, once all moves are known
+    d_ptr->m_RouteTimer.setSingleShot(true);
+    d_ptr->m_RouteTimer.setInterval(0);
+
+    connect(&d_ptr->m_RouteTimer, &QTimer::timeout,
+        d_ptr, &QNodeEditorSocketModelPrivate::slotFlushRoutes);
+
     rmodel->setCurrentProxy(this);
 }
 
 QNodeEditorSocketModel::~QNodeEditorSocketModel()
 {
+    // Wait for the worker before the edges are gone
+    delete d_ptr->m_pRouter;
+    d_ptr->m_pRouter = Q_NULLPTR;
+
     while (!d_ptr->m_lEdges.isEmpty())
         delete d_ptr->m_lEdges.takeLast();
 
@@ -220,6 +372,22 @@ void QNodeEditorSocketModel::setSourceModel(QAbstractItemModel *sm)
     d_ptr->slotRowsInserted({}, 0, sourceModel()->rowCount() -1 );
 }
 
+QVariant QNodeEditorSocketModel::data(const QModelIndex& idx, int role) const
+{
+    // The colours are still resolved here, they use the (fused) base role
+    if (d_ptr->m_pFusedTree && idx.isValid() && idx.model() == this
+      && role != Qt::BackgroundRole && role != Qt::ForegroundRole) {
+        const auto src = d_ptr->m_pFusedTree->mapToSource(
+            idx.row(), idx.column(), idx.internalId()
+        );
+
+        if (src.isValid())
+            return src.data(role);
+    }
+
+    return QTypeColoriserProxy::data(idx, role);
+}
+
 bool QNodeEditorSocketModel::setData(const QModelIndex &idx, const QVariant &value, int role)
 {
     if (!idx.isValid())
@@ -228,15 +396,29 @@ bool QNodeEditorSocketModel::setData(const QModelIndex &idx, const QVariant &val
     if (role == Qt::SizeHintRole && value.canConvert<QRectF>() && !idx.parent().isValid()) {
         auto n = d_ptr->getNode(idx);
         Q_ASSERT(n);
+        const QRectF oldRect = n->m_SceneRect;
         n->m_SceneRect = value.toRectF();
+        d_ptr->updateCells(n);
 
-        Q_EMIT dataChanged(idx, idx);
+        // Everything is refreshed at once in endBatchUpdate()
+        if (d_ptr->m_BatchDepth)
+            return true;
+
+        if (d_ptr->m_pRouter)
+            d_ptr->invalidateRoutes(n, oldRect);
+
+        // Only realize here, the items being moved may be dragged by the
+        // mouse and must not be taken away
+        if (!n->m_Node.isRealized())
+            d_ptr->updateRealization(n);
+
+        Q_EMIT dataChanged(idx, idx, {Qt::SizeHintRole});
 
         // All socket position also changed
         const int cc = rowCount(idx);
 
         if (cc)
-            Q_EMIT dataChanged(index(0,0,idx), index(cc -1, 0, idx));
+            Q_EMIT dataChanged(index(0,0,idx), index(cc -1, 0, idx), {Qt::SizeHintRole});
 
         return true;
     }
@@ -244,15 +426,358 @@ bool QNodeEditorSocketModel::setData(const QModelIndex &idx, const QVariant &val
     return QTypeColoriserProxy::setData(idx, value, role);
 }
 
+void QNodeEditorSocketModel::beginBatchUpdate()
+{
+    d_ptr->m_BatchDepth++;
+}
+
+void QNodeEditorSocketModel::endBatchUpdate()
+{
+    Q_ASSERT(d_ptr->m_BatchDepth > 0);
+
+    if (--d_ptr->m_BatchDepth)
+        return;
+
+    const int count = rowCount();
+
+    if (!count)
+        return;
+
+    for (auto nw : qAsConst(d_ptr->m_lWrappers))
+        d_ptr->updateRealization(nw);
+
+    // The edges are updated directly rather than by the individual changes
+    // of every socket going through the proxies
+    for (auto e : qAsConst(d_ptr->m_lEdges)) {
+        if (!e)
+            continue;
+
+        e->m_Edge.update();
+        d_ptr->scheduleRoute(e);
+    }
+
+    Q_EMIT dataChanged(index(0, 0), index(count - 1, 0), {Qt::SizeHintRole});
+}
+
+bool QNodeEditorSocketModel::isVirtualized() const
+{
+    return d_ptr->m_IsVirtualized;
+}
+
+void QNodeEditorSocketModel::setVirtualized(bool value)
+{
+    if (d_ptr->m_IsVirtualized == value)
+        return;
+
+    d_ptr->m_IsVirtualized = value;
+
+    for (auto nw : qAsConst(d_ptr->m_lWrappers))
+        d_ptr->updateRealization(nw);
+}
+
+bool QNodeEditorSocketModel::isFused() const
+{
+    return d_ptr->m_IsFused;
+}
+
+void QNodeEditorSocketModel::setFused(bool value)
+{
+    d_ptr->m_IsFused = value;
+    d_ptr->updateFusion();
+}
+
+void QNodeEditorSocketModelPrivate::updateFusion()
+{
+    // The reactive model doesn't change the data, so the leaf models can be
+    // read directly
+    const auto reactive = m_IsFused ?
+        qobject_cast<QReactiveProxyModel*>(q_ptr->sourceModel()) : Q_NULLPTR;
+
+    m_pFusedTree = reactive ?
+        qobject_cast<QMultiModelTree*>(reactive->sourceModel()) : Q_NULLPTR;
+}
+
+void QNodeEditorSocketModel::setRealizedArea(const QRectF& area)
+{
+    const QRectF old = d_ptr->m_RealizedArea;
+    d_ptr->m_RealizedArea = area;
+
+    if (!d_ptr->m_IsVirtualized)
+        return;
+
+    const QRect oldCells = nodeCells(old ), newCells = nodeCells(area);
+
+    const qint64 cellCount = qint64(oldCells.width()) * oldCells.height()
+        + qint64(newCells.width()) * newCells.height();
+
+    // A null area realizes everything. When zoomed out, looking at each
+    // node is cheaper than looking at each cell.
+    if (old.isNull() || area.isNull() || cellCount > d_ptr->m_lWrappers.size()) {
+        for (auto nw : qAsConst(d_ptr->m_lWrappers))
+            d_ptr->updateRealization(nw);
+
+        return;
+    }
+
+    // Only the nodes entering or leaving the area change
+    QSet<NodeWrapper*> nodes = d_ptr->m_hPinned;
+    d_ptr->nodesIn(old , nodes);
+    d_ptr->nodesIn(area, nodes);
+
+    for (auto nw : qAsConst(nodes)) {
+        const QRectF r = nw->m_Node.rect();
+
+        if (old.intersects(r) != area.intersects(r) || d_ptr->m_hPinned.contains(nw))
+            d_ptr->updateRealization(nw);
+    }
+}
+
+void QNodeEditorSocketModelPrivate::nodesIn(const QRectF& area, QSet<NodeWrapper*>& nodes) const
+{
+    collectFromGrid(m_hNodeCells, area, nodes);
+}
+
+void QNodeEditorSocketModelPrivate::updateCells(NodeWrapper* nw, bool remove)
+{
+    const QRect cells = remove ? QRect() : nodeCells(nw->m_Node.rect());
+
+    moveInGrid(m_hNodeCells, nw, nw->m_Cells, cells);
+}
+
+void QNodeEditorSocketModelPrivate::updateRealization(NodeWrapper* nw)
+{
+    // Until a view sets the area, there is no way to know what is visible
+    const bool visible = m_IsDetailed && (
+           (!m_IsVirtualized)
+        || m_RealizedArea.isNull()
+        || m_RealizedArea.intersects(nw->m_Node.rect())
+    );
+
+    const bool pinned = (!visible) && nw->m_Node.graphicsItem()
+        && nw->m_Node.graphicsItem()->isSelected();
+
+    // Don't pull the item from under the mouse
+    if (visible)
+        nw->m_Node.realize(&m_ItemPool);
+    else if (!pinned)
+        nw->m_Node.unrealize(&m_ItemPool);
+
+    // Check them again on the next area change
+    if (pinned)
+        m_hPinned.insert(nw);
+    else
+        m_hPinned.remove(nw);
+
+    // Some nodes cannot be unrealized, hide them
+    if (auto item = nw->m_Node.graphicsItem())
+        item->setVisible(m_IsDetailed);
+}
+
+bool QNodeEditorSocketModel::areDetailedItemsVisible() const
+{
+    return d_ptr->m_IsDetailed;
+}
+
+void QNodeEditorSocketModel::setDetailedItemsVisible(bool value)
+{
+    if (d_ptr->m_IsDetailed == value)
+        return;
+
+    d_ptr->m_IsDetailed = value;
+
+    for (auto nw : qAsConst(d_ptr->m_lWrappers))
+        d_ptr->updateRealization(nw);
+
+    for (auto e : qAsConst(d_ptr->m_lEdges)) {
+        if (e)
+            e->m_Edge.graphicsItem()->setVisible(value);
+    }
+}
+
+void QNodeEditorSocketModel::overviewGeometry(QVector<QRectF>& nodes, QVector<QLineF>& edges) const
+{
+    nodes.resize(d_ptr->m_lWrappers.size());
+
+    for (int i = 0; i < d_ptr->m_lWrappers.size(); i++)
+        nodes[i] = d_ptr->m_lWrappers[i]->m_Node.rect();
+
+    edges.clear();
+    edges.reserve(d_ptr->m_lEdges.size());
+
+    // Half connected edges are being dragged, they are never in the overview
+    for (auto e : qAsConst(d_ptr->m_lEdges)) {
+        if (e && e->m_pSource && e->m_pSink)
+            edges << QLineF(
+                e->m_pSource->m_Socket.d_ptr->sceneAnchorPos(),
+                e->m_pSink->m_Socket.d_ptr->sceneAnchorPos()
+            );
+    }
+}
+
+QNodeEditorSocketModel::EdgeStyle QNodeEditorSocketModel::edgeStyle() const
+{
+    return d_ptr->m_pRouter ? EdgeStyle::ORTHOGONAL : EdgeStyle::BEZIER;
+}
+
+void QNodeEditorSocketModel::setEdgeStyle(EdgeStyle style)
+{
+    if (style == edgeStyle())
+        return;
+
+    if (style == EdgeStyle::BEZIER) {
+        delete d_ptr->m_pRouter;
+        d_ptr->m_pRouter = Q_NULLPTR;
+        d_ptr->m_hDirtyRoutes.clear();
+        d_ptr->m_hRouteCells.clear();
+
+        for (auto e : qAsConst(d_ptr->m_lEdges)) {
+            if (!e)
+                continue;
+
+            e->m_Edge.d_ptr->m_lRoute.clear();
+            e->m_Edge.d_ptr->m_RouteBounds = {};
+            e->m_RouteCells = {};
+            e->m_Edge.update();
+        }
+
+        return;
+    }
+
+    d_ptr->m_pRouter = new EdgeRouter([this](const QVector<EdgeRoute>& routes) {
+        d_ptr->applyRoutes(routes);
+    });
+
+    for (auto e : qAsConst(d_ptr->m_lEdges))
+        d_ptr->scheduleRoute(e);
+}
+
+void QNodeEditorSocketModelPrivate::scheduleRoute(EdgeWrapper* e)
+{
+    if (!(m_pRouter && e && e->m_pSource && e->m_pSink))
+        return;
+
+    m_hDirtyRoutes.insert(e->m_Edge.index().row());
+    m_RouteTimer.start();
+}
+
+void QNodeEditorSocketModelPrivate::invalidateRoutes(NodeWrapper* nw, const QRectF& oldRect)
+{
+    // The edges of the node itself
+    for (auto sw : qAsConst(nw->m_lSources))
+        scheduleRoute(sw->m_EdgeWrapper);
+
+    for (auto sw : qAsConst(nw->m_lSinks))
+        scheduleRoute(sw->m_EdgeWrapper);
+
+    // The ones going through the old or new position
+    const QRectF newRect = nw->m_SceneRect;
+
+    QSet<EdgeWrapper*> edges;
+    collectFromGrid(m_hRouteCells, oldRect, edges);
+    collectFromGrid(m_hRouteCells, newRect, edges);
+
+    for (auto e : qAsConst(edges)) {
+        const QRectF& b = e->m_Edge.d_ptr->m_RouteBounds;
+
+        if (b.isValid() && (b.intersects(newRect) || b.intersects(oldRect)))
+            scheduleRoute(e);
+    }
+}
+
+void QNodeEditorSocketModelPrivate::slotFlushRoutes()
+{
+    if ((!m_pRouter) || m_hDirtyRoutes.isEmpty())
+        return;
+
+    QVector<QRectF> obstacles;
+    obstacles.reserve(m_lWrappers.size());
+
+    for (auto nw : qAsConst(m_lWrappers))
+        obstacles << nw->m_Node.rect();
+
+    QVector<EdgeRouteRequest> requests;
+    requests.reserve(m_hDirtyRoutes.size());
+
+    for (const int row : qAsConst(m_hDirtyRoutes)) {
+        auto e = row < m_lEdges.size() ? m_lEdges[row] : Q_NULLPTR;
+
+        if (!(e && e->m_pSource && e->m_pSink))
+            continue;
+
+        e->m_Edge.d_ptr->m_RouteSerial = ++m_RouteSerial;
+
+        requests << EdgeRouteRequest {
+            row,
+            m_RouteSerial,
+            e->m_pSource->m_Socket.d_ptr->sceneAnchorPos(),
+            e->m_pSink->m_Socket.d_ptr->sceneAnchorPos()
+        };
+    }
+
+    m_hDirtyRoutes.clear();
+
+    m_pRouter->route(obstacles, requests);
+}
+
+void QNodeEditorSocketModelPrivate::applyRoutes(const QVector<EdgeRoute>& routes)
+{
+    for (const auto& r : routes) {
+        auto e = r.m_Row < m_lEdges.size() ? m_lEdges[r.m_Row] : Q_NULLPTR;
+
+        // Stale, a newer request is pending or the edge was reconnected
+        if ((!e) || e->m_Edge.d_ptr->m_RouteSerial != r.m_Serial)
+            continue;
+
+        QRectF bounds;
+
+        for (const auto& p : r.m_lPoints)
+            bounds |= QRectF(p, QSizeF(1, 1));
+
+        e->m_Edge.d_ptr->m_lRoute      = r.m_lPoints;
+        e->m_Edge.d_ptr->m_RouteBounds = bounds;
+        moveInGrid(m_hRouteCells, e, e->m_RouteCells,
+            bounds.isValid() ? nodeCells(bounds) : QRect());
+        e->m_Edge.update();
+    }
+}
+
+QRectF QNodeEditorSocketModel::nodesBoundingRect() const
+{
+    QRectF ret;
+
+    for (auto nw : qAsConst(d_ptr->m_lWrappers))
+        ret |= nw->m_Node.rect();
+
+    return ret;
+}
+
+void QNodeEditorSocketModel::snapshot(SceneSnapshot& s, const QRectF& area) const
+{
+    for (auto nw : qAsConst(d_ptr->m_lWrappers)) {
+        if (nw->m_Node.rect().intersects(area))
+            nw->m_Node.snapshot(s);
+    }
+
+    for (auto e : qAsConst(d_ptr->m_lEdges)) {
+        if (!(e && e->m_IsShown))
+            continue;
+
+        const auto path = static_cast<QGraphicsPathItem*>(
+            e->m_Edge.graphicsItem()
+        )->path();
+
+        if (path.controlPointRect().intersects(area))
+            s.m_lEdges << SceneSnapshot::Edge { path, e->m_Edge.d_ptr->m_Pen };
+    }
+}
+
 QMimeData *QNodeEditorSocketModel::mimeData(const QModelIndexList &idxs) const
 {
     auto md = QTypeColoriserProxy::mimeData(idxs);
 
     // Assume the QMimeData exist only while the data is being dragged
     if (md) {
-        const QModelDataListDecoder decoder(md);
-
-        auto typeId = decoder.typeId(Qt::EditRole);
+        const auto typeId = QReactiveProxyModel::draggedTypeId(md);
 
         if (typeId != QMetaType::UnknownType) {
             d_ptr->m_State = QNodeEditorSocketModelPrivate::State::DRAGGING;
@@ -319,15 +844,13 @@ GraphicsNode* QNodeEditorSocketModel::getNode(const QModelIndex& idx, bool recur
     if ((!idx.isValid()) || idx.model() != this)
         return Q_NULLPTR;
 
-    const auto i = (recursive && idx.parent().isValid()) ? idx.parent() : idx;
-
-    auto nodew = d_ptr->getNode(i);
+    auto nodew = d_ptr->getNode(idx, recursive);
 
     return nodew ? &nodew->m_Node : Q_NULLPTR;
 }
 
 template<
-    QVector<int> NodeWrapper::* SM,
+    QHash<QModelIndex, int> NodeWrapper::* SM,
     QVector<SocketWrapper*> NodeWrapper::* S,
     SocketWrapper* EdgeWrapper::* E
 >
@@ -348,9 +871,13 @@ SocketWrapper* QNodeEditorSocketModelPrivate::getSocketCommon(const QModelIndex&
     if (!nodew)
         return Q_NULLPTR;
 
-    // The -1 is because int defaults to 0 and invalid is -1
-    const int relIdx = ((*nodew).*SM).size() > idx.row() ?
-        ((*nodew).*SM)[idx.row()] - 1 : -1;
+    // The sockets are indexed by their first column
+    auto i = idx.model() == q_ptr->sourceModel() ? q_ptr->mapFromSource(idx) : idx;
+
+    if (i.column())
+        i = i.sibling(i.row(), 0);
+
+    const int relIdx = ((*nodew).*SM).value(i, -1);
 
     auto ret = relIdx != -1 ? ((*nodew).*S)[relIdx] : Q_NULLPTR;
 
@@ -362,28 +889,28 @@ SocketWrapper* QNodeEditorSocketModelPrivate::getSocketCommon(const QModelIndex&
 SocketWrapper* QNodeEditorSocketModelPrivate::getSourceSocket(const QModelIndex& idx) const
 {
     return getSocketCommon<
-        &NodeWrapper::m_lSourcesFromSrc, &NodeWrapper::m_lSources, &EdgeWrapper::m_pSource
+        &NodeWrapper::m_hSourcesFromSrc, &NodeWrapper::m_lSources, &EdgeWrapper::m_pSource
     >(idx);
 }
 
 SocketWrapper* QNodeEditorSocketModelPrivate::getSinkSocket(const QModelIndex& idx) const
 {
     return getSocketCommon<
-        &NodeWrapper::m_lSinksFromSrc, &NodeWrapper::m_lSinks, &EdgeWrapper::m_pSink
+        &NodeWrapper::m_hSinksFromSrc, &NodeWrapper::m_lSinks, &EdgeWrapper::m_pSink
     >(idx);
 }
 
 GraphicsNodeSocket* QNodeEditorSocketModel::getSourceSocket(const QModelIndex& idx)
 {
     return &d_ptr->getSocketCommon<
-        &NodeWrapper::m_lSourcesFromSrc, &NodeWrapper::m_lSources, &EdgeWrapper::m_pSource
+        &NodeWrapper::m_hSourcesFromSrc, &NodeWrapper::m_lSources, &EdgeWrapper::m_pSource
     >(idx)->m_Socket;
 }
 
 GraphicsNodeSocket* QNodeEditorSocketModel::getSinkSocket(const QModelIndex& idx)
 {
     return &d_ptr->getSocketCommon<
-        &NodeWrapper::m_lSinksFromSrc, &NodeWrapper::m_lSinks, &EdgeWrapper::m_pSink
+        &NodeWrapper::m_hSinksFromSrc, &NodeWrapper::m_lSinks, &EdgeWrapper::m_pSink
     >(idx)->m_Socket;
 }
 
@@ -490,11 +1017,14 @@ void QNodeEditorSocketModelPrivate::slotRowsInserted(const QModelIndex& parent,
             const auto idx = q_ptr->index(i, 0);
             if (idx.isValid()) {
                 insertNode(idx.row());
-                slotRowsInserted(idx, 0, q_ptr->rowCount(idx));
+                slotRowsInserted(idx, 0, q_ptr->rowCount(idx) - 1);
             }
         }
+
+        // The rows of the nodes after them changed
+        remapNodes(last + 1);
     }
-    else if (!parent.parent().isValid())
+    else
         insertSockets(parent, first, last);
 }
 
@@ -511,7 +1041,8 @@ GraphicsNode* QNodeEditorSocketModelPrivate::insertNode(int idx)
 
     m_lWrappers.insert(idx, nw);
 
-    m_pScene->addItem(nw->m_Node.graphicsItem());
+    updateCells(nw);
+    updateRealization(nw);
 
     return &nw->m_Node;
 }
@@ -524,7 +1055,8 @@ NodeWrapper* QNodeEditorSocketModelPrivate::getNode(const QModelIndex& idx, bool
     if ((!i.isValid()) || i.model() != q_ptr)
         return Q_NULLPTR;
 
-    if (i.parent().isValid() && r)
+    // The nested sockets too
+    while (i.parent().isValid() && r)
         i = i.parent();
 
     if (i.parent().isValid())
@@ -544,68 +1076,57 @@ NodeWrapper* QNodeEditorSocketModelPrivate::getNode(const QModelIndex& idx, bool
 
 void QNodeEditorSocketModelPrivate::insertSockets(const QModelIndex& parent, int first, int last)
 {
-    Q_UNUSED(first)
-    Q_UNUSED(last)
-
-    auto nodew = getNode(parent);
+    auto nodew = getNode(parent, true);
     Q_ASSERT(nodew);
 
-    Q_ASSERT(parent.isValid() && (!parent.parent().isValid()));
-
     Q_ASSERT(parent.model() == q_ptr);
 
-    Q_ASSERT(nodew->m_lSourcesFromSrc.size() >= first);
-    Q_ASSERT(nodew->m_lSinksFromSrc.size() >= first);
-
-    for (int i = first; i <= last; i++) {
-        const auto idx = q_ptr->index(i, 0, parent);
+    for (int i = first; i <= last; i++)
+        createSockets(nodew, q_ptr->index(i, 0, parent));
 
-        // It doesn't attempt to insert the socket at the correct index as
-        // many items will be rejected
+    // The rows after them moved too
+    remapSockets(nodew);
+}
 
-        constexpr static const Qt::ItemFlags sourceFlags(
-            Qt::ItemIsDragEnabled |
-            Qt::ItemIsSelectable
-        );
+void QNodeEditorSocketModelPrivate::createSockets(NodeWrapper* nodew, const QModelIndex& idx)
+{
+    // It doesn't attempt to insert the socket at the correct index as
+    // many items will be rejected, remapSockets() puts them in order
 
-        // SOURCES
-        if ((idx.flags() & sourceFlags) == sourceFlags) {
-            auto s = new SocketWrapper(
-                idx,
-                GraphicsNodeSocket::SocketType::SOURCE,
-                nodew
-            );
-            nodew->m_lSourcesFromSrc.insert(i, nodew->m_lSources.size() + 1);
-            nodew->m_lSources << s;
-            nodew->m_lSourcesToSrc << i;
-        }
-        else
-            nodew->m_lSourcesFromSrc.insert(i, 0);
+    constexpr static const Qt::ItemFlags sourceFlags(
+        Qt::ItemIsDragEnabled |
+        Qt::ItemIsSelectable
+    );
 
-        constexpr static const Qt::ItemFlags sinkFlags(
-            Qt::ItemIsDropEnabled |
-            Qt::ItemIsSelectable  |
-            Qt::ItemIsEditable
+    // SOURCES
+    if ((idx.flags() & sourceFlags) == sourceFlags) {
+        nodew->m_lSources << new SocketWrapper(
+            idx,
+            GraphicsNodeSocket::SocketType::SOURCE,
+            nodew
         );
+    }
 
-        // SINKS
-        if ((idx.flags() & sinkFlags) == sinkFlags) {
-            auto s = new SocketWrapper(
-                idx,
-                GraphicsNodeSocket::SocketType::SINK,
-                nodew
-            );
-            nodew->m_lSinksFromSrc.insert(i, nodew->m_lSinks.size() + 1);
-            nodew->m_lSinks << s;
-            nodew->m_lSinksToSrc << i;
-        }
-        else
-            nodew->m_lSinksFromSrc.insert(i, 0);
+    constexpr static const Qt::ItemFlags sinkFlags(
+        Qt::ItemIsDropEnabled |
+        Qt::ItemIsSelectable  |
+        Qt::ItemIsEditable
+    );
 
-        nodew->m_Node.update();
+    // SINKS
+    if ((idx.flags() & sinkFlags) == sinkFlags) {
+        nodew->m_lSinks << new SocketWrapper(
+            idx,
+            GraphicsNodeSocket::SocketType::SINK,
+            nodew
+        );
     }
 
-    Q_ASSERT(nodew->m_lSinksFromSrc.size() == nodew->m_lSourcesFromSrc.size());
+    // The nested rows, such as grouped properties, are sockets too
+    const int count = q_ptr->rowCount(idx);
+
+    for (int i = 0; i < count; i++)
+        createSockets(nodew, q_ptr->index(i, 0, idx));
 }
 
 void QNodeEditorSocketModelPrivate::updateSockets(const QModelIndex& parent, int first, int last)
@@ -710,14 +1231,14 @@ QVariant QNodeEditorEdgeModel::data(const QModelIndex& idx, int role) const
         srcIdx.model() == d_ptr->q_ptr->edgeModel()
     );
 
-    if (srcIdx.model() == d_ptr->q_ptr && srcIdx.parent().isValid()) //TODO remove
+    if (srcIdx.model() == d_ptr->q_ptr && srcIdx.parent().isValid() && !srcIdx.parent().parent().isValid()) //TODO remove
         Q_ASSERT(srcIdx.parent().data() == d_ptr->q_ptr->index(srcIdx.parent().row(),0).data());
 
     auto sock = (!idx.column()) ?
         d_ptr->getSourceSocket(srcIdx) : d_ptr->getSinkSocket(srcIdx);
 
     if (sock && role == Qt::SizeHintRole)
-        return sock->m_Socket.graphicsItem()->mapToScene(0,0);
+        return sock->m_Socket.d_ptr->sceneAnchorPos();
 
     return QIdentityProxyModel::data(idx, role);
 }
@@ -799,9 +1320,13 @@ void QNodeEditorSocketModelPrivate::slotConnectionsChanged(const QModelIndex& tl
         const bool isUsed = e->m_pSource || e->m_pSink;
 
         e->m_Edge.update();
+        e->m_Edge.updateStyle();
+        scheduleRoute(e);
 
-        if (e->m_IsShown != isUsed && isUsed)
+        if (e->m_IsShown != isUsed && isUsed) {
+            e->m_Edge.graphicsItem()->setVisible(m_IsDetailed);
             m_pScene->addItem(e->m_Edge.graphicsItem());
+        }
         else if (e->m_IsShown != isUsed && !isUsed)
             m_pScene->removeItem(e->m_Edge.graphicsItem());
 
@@ -809,6 +1334,59 @@ void QNodeEditorSocketModelPrivate::slotConnectionsChanged(const QModelIndex& tl
     }
 }
 
+void QNodeEditorSocketModelPrivate::slotDataChanged(const QModelIndex& tl, const QModelIndex& br, const QVector<int>& roles)
+{
+    // The colors are derived from the type, so the EditRole matters too
+    static const QVector<int> styleRoles {
+        Qt::DisplayRole, Qt::EditRole, Qt::BackgroundRole, Qt::ForegroundRole
+    };
+
+    if (!roles.isEmpty()) {
+        if (std::none_of(roles.constBegin(), roles.constEnd(), [](int r) {
+            return styleRoles.contains(r);
+        }))
+            return;
+    }
+
+    const bool fgChanged = roles.isEmpty() || roles.contains(Qt::ForegroundRole);
+
+    for (int i = tl.row(); i <= br.row(); i++) {
+        const auto idx = q_ptr->index(i, 0, tl.parent());
+
+        // Nodes, the sockets text defaults to the node foreground
+        if (!tl.parent().isValid()) {
+            auto nw = getNode(idx);
+
+            if (!nw)
+                continue;
+
+            nw->m_Node.updateStyle();
+
+            if (!fgChanged)
+                continue;
+
+            for (auto sw : qAsConst(nw->m_lSources))
+                sw->m_Socket.updateStyle();
+
+            for (auto sw : qAsConst(nw->m_lSinks))
+                sw->m_Socket.updateStyle();
+
+            continue;
+        }
+
+        // The edges use the socket background as line color
+        for (auto sw : {getSourceSocket(idx), getSinkSocket(idx)}) {
+            if (!sw)
+                continue;
+
+            sw->m_Socket.updateStyle();
+
+            if (sw->m_EdgeWrapper)
+                sw->m_EdgeWrapper->m_Edge.updateStyle();
+        }
+    }
+}
+
 void QNodeEditorSocketModelPrivate::slotAboutRemoveItem(const QModelIndex &parent, int first, int last)
 {
     if (first < 0 || last < first)
@@ -816,7 +1394,8 @@ void QNodeEditorSocketModelPrivate::slotAboutRemoveItem(const QModelIndex &paren
 
     if (!parent.isValid() && m_lWrappers.size() > last) {
 
-        for (int i = first; i <= last; i++) {
+        // Backward, so the rows and the wrappers stay aligned
+        for (int i = last; i >= first; i--) {
             const auto idx = q_ptr->index(i, 0, parent);
 
             // remove the sockets
@@ -824,71 +1403,181 @@ void QNodeEditorSocketModelPrivate::slotAboutRemoveItem(const QModelIndex &paren
 
             auto nw = m_lWrappers[i];
             nw->m_Node.setCentralWidget(Q_NULLPTR);
-            m_pScene->removeItem(nw->m_Node.graphicsItem());
 
-            m_lWrappers.remove(i - (i-first));
+            if (auto item = nw->m_Node.graphicsItem())
+                m_pScene->removeItem(item);
+
+            m_lWrappers.remove(i);
+
+            updateCells(nw, true);
+            m_hPinned.remove(nw);
 
             delete nw;
         }
     }
-    else if (parent.isValid() && !parent.parent().isValid()) {
-        auto nw = m_lWrappers[parent.row()];
+    else if (parent.isValid()) {
+        auto nw = getNode(parent, true);
         Q_ASSERT(nw);
 
-        QList<int> srcToDel, sinkToDel;
+        // The removed rows and everything nested below them
+        const auto isRemoved = [&parent, first, last](QModelIndex i) -> bool {
+            for (; i.isValid(); i = i.parent()) {
+                if (i.parent() == parent)
+                    return i.row() >= first && i.row() <= last;
+            }
 
-        for (int i = first; i <= last; i++) {
-            Q_ASSERT(parent == nw->m_Node.index());
+            return false;
+        };
 
-            Q_ASSERT(nw->m_lSinksFromSrc.size() == nw->m_lSourcesFromSrc.size());
-            Q_ASSERT(nw->m_lSourcesFromSrc.size() > q_ptr->rowCount(parent));
+        const auto remove = [this, &isRemoved](QVector<SocketWrapper*>& sockets) {
+            QVector<SocketWrapper*> kept;
+            kept.reserve(sockets.size());
 
-            int sid = nw->m_lSourcesFromSrc[i] - 1;
-            if (sid >= 0) {
-                auto sw = nw->m_lSources[sid];
-                m_pScene->removeItem(sw->m_Socket.graphicsItem());
-                srcToDel << sid;
-                delete sw;
-            }
+            for (auto sw : qAsConst(sockets)) {
+                if (!isRemoved(sw->m_Socket.index())) {
+                    kept << sw;
+                    continue;
+                }
+
+                m_pScene->removeSocket(&sw->m_Socket);
 
-            sid = nw->m_lSinksFromSrc[i] - 1;
+                if (auto item = sw->m_Socket.graphicsItem())
+                    m_pScene->removeItem(item);
 
-            if (sid >= 0) {
-                auto sw = nw->m_lSinks[sid];
-                m_pScene->removeItem(sw->m_Socket.graphicsItem());
-                sinkToDel << sid;
                 delete sw;
             }
-        }
 
-        nw->m_lSinksFromSrc.remove(first, last - first + 1);
-        nw->m_lSourcesFromSrc.remove(first, last - first + 1);
+            sockets = kept;
+        };
+
+        remove(nw->m_lSources);
+        remove(nw->m_lSinks  );
+
+        // The rows are still there, the mapping is rebuilt again once they
+        // are gone (slotRowsRemoved)
+        remapSockets(nw);
+    }
+}
+
+void QNodeEditorSocketModelPrivate::remapSockets(NodeWrapper* nw)
+{
+    typedef QPair<QVector<int>, SocketWrapper*> SocketPath;
+
+    // The (persistent) socket indices are the only source of truth. They are
+    // sorted by the rows from the node down to them, so depth first
+    const auto remap = [](QVector<SocketWrapper*>& sockets, QHash<QModelIndex, int>& fromSrc) {
+        QVector<SocketPath> paths;
+        paths.reserve(sockets.size());
+
+        for (auto sw : qAsConst(sockets)) {
+            QVector<int> path;
 
-        // remove from the list, this assume the sockets are ordered
-        for (int i = 0; i < srcToDel.size(); i++) {
-            nw->m_lSources.remove(srcToDel[i] - i);
-            nw->m_lSourcesToSrc.remove(srcToDel[i] - i);
+            for (QModelIndex i = sw->m_Socket.index(); i.parent().isValid(); i = i.parent())
+                path.prepend(i.row());
+
+            paths << qMakePair(path, sw);
         }
 
-        for (int i = 0; i < sinkToDel.size(); i++) {
-            nw->m_lSinks.remove(sinkToDel[i] - i);
-            nw->m_lSinksToSrc.remove(sinkToDel[i] - i);
+        std::stable_sort(paths.begin(), paths.end(), [](const SocketPath& a, const SocketPath& b) {
+            return std::lexicographical_compare(
+                a.first.constBegin(), a.first.constEnd(),
+                b.first.constBegin(), b.first.constEnd()
+            );
+        });
+
+        fromSrc.clear();
+        fromSrc.reserve(sockets.size());
+
+        for (int i = 0; i < paths.size(); i++) {
+            sockets[i] = paths[i].second;
+
+            const QModelIndex idx = sockets[i]->m_Socket.index();
+
+            if (idx.isValid())
+                fromSrc[idx] = i;
         }
+    };
+
+    remap(nw->m_lSources, nw->m_hSourcesFromSrc);
+    remap(nw->m_lSinks  , nw->m_hSinksFromSrc  );
 
-        // reload the "FromSrc" mapping
-        int rc(q_ptr->rowCount(parent) - (last - first) - 1), csrc(0), csink(0);
-        for (int i = 0; i < rc; i++) {
-            const auto idx2 = q_ptr->index(i, 0, parent);
+    nw->m_Node.update();
+}
 
-            nw->m_lSourcesFromSrc[i] = (csrc < nw->m_lSources.size()
-                && nw->m_lSources[csrc]->m_Socket.index() == idx2
-                && ++csrc) ? csrc : -1;
+void QNodeEditorSocketModelPrivate::remapNodes(int first)
+{
+    // Depending on the source model, the socket indices can change with the
+    // row of their node
+    for (int i = std::max(first, 0); i < m_lWrappers.size(); i++)
+        remapSockets(m_lWrappers[i]);
+}
 
-            nw->m_lSinksFromSrc[i] = (csink < nw->m_lSinks.size()
-                && nw->m_lSinks[csink]->m_Socket.index() == idx2
-                && ++csink) ? csink : -1;
+void QNodeEditorSocketModelPrivate::slotRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(last)
+
+    // The nodes themselves are already handled in slotAboutRemoveItem
+    if (parent.isValid())
+        remapSockets(getNode(parent, true));
+    else
+        remapNodes(first);
+}
+
+void QNodeEditorSocketModelPrivate::slotAboutMoveItem(const QModelIndex& parent, int first, int last, const QModelIndex& destination, int row)
+{
+    Q_UNUSED(row)
+
+    // The sockets moved to another parent are deleted and created again
+    // once the rows are there
+    if (parent != destination && parent.isValid())
+        slotAboutRemoveItem(parent, first, last);
+}
+
+void QNodeEditorSocketModelPrivate::slotRowsMoved(const QModelIndex& parent, int first, int last, const QModelIndex& destination, int row)
+{
+    // The nodes, the wrappers follow the (persistent) node indices
+    if ((!parent.isValid()) && !destination.isValid()) {
+        std::stable_sort(m_lWrappers.begin(), m_lWrappers.end(), [](NodeWrapper* a, NodeWrapper* b) {
+            return a->m_Node.index().row() < b->m_Node.index().row();
+        });
+
+        remapNodes(std::min(first, row));
+
+        return;
+    }
+
+    if (parent.isValid())
+        remapSockets(getNode(parent, true));
+
+    if (destination == parent || !destination.isValid())
+        return;
+
+    if (parent.isValid())
+        insertSockets(destination, row, row + last - first);
+}
+
+void QNodeEditorSocketModelPrivate::slotLayoutChanged(const QList<QPersistentModelIndex>& parents)
+{
+    if (parents.isEmpty()) {
+        remapNodes(0);
+        return;
+    }
+
+    QSet<NodeWrapper*> nodes;
+
+    for (const auto& p : parents) {
+        // The nodes themselves, all their sockets may have moved
+        if (!p.isValid()) {
+            remapNodes(0);
+            return;
         }
+
+        if (auto nw = getNode(p, true))
+            nodes.insert(nw);
     }
+
+    for (auto nw : qAsConst(nodes))
+        remapSockets(nw);
 }
 
 QNodeEditorSocketModel* QNodeEditorEdgeModel::socketModel() const
@@ -896,6 +1585,49 @@ QNodeEditorSocketModel* QNodeEditorEdgeModel::socketModel() const
     return d_ptr->q_ptr;
 }
 
+QVector< QPair<int, int> > QNodeEditorEdgeModel::nodeConnections() const
+{
+    typedef QReactiveProxyModel::ConnectionsRoles   CRole;
+    typedef QReactiveProxyModel::ConnectionsColumns CColumn;
+
+    const auto sm = d_ptr->q_ptr;
+    const int  ec = rowCount();
+
+    // The nested sockets belong to the node at the top of their rows
+    const auto nodeRow = [](QModelIndex i) -> int {
+        while (i.parent().isValid())
+            i = i.parent();
+
+        return i.row();
+    };
+
+    QVector< QPair<int, int> > ret;
+    ret.reserve(ec);
+
+    for (int i = 0; i < ec; i++) {
+        // The data is the QReactiveProxyModel indices
+        const auto src = sm->mapFromSource(
+            index(i, CColumn::SOURCE).data(CRole::SOURCE_INDEX).toModelIndex()
+        );
+        const auto dst = sm->mapFromSource(
+            index(i, CColumn::DESTINATION).data(CRole::DESTINATION_INDEX).toModelIndex()
+        );
+
+        if (!(src.parent().isValid() && dst.parent().isValid()))
+            continue;
+
+        const int u = nodeRow(src), v = nodeRow(dst);
+
+        if (u != v)
+            ret << qMakePair(u, v);
+    }
+
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+
+    return ret;
+}
+
 QNodeEdgeFilterProxy::QNodeEdgeFilterProxy(QNodeEditorSocketModelPrivate* d, NodeWrapper *w, GraphicsNodeSocket::SocketType t) :
     QAbstractProxyModel(d), m_Type(t), m_pWrapper(w), d_ptr(d)
 {
@@ -919,27 +1651,24 @@ int QNodeEdgeFilterProxy::rowCount(const QModelIndex& parent) const
 
 QModelIndex QNodeEdgeFilterProxy::mapFromSource(const QModelIndex& srcIdx) const
 {
-    static const auto check = [](
-        const QVector<int>& l, const QModelIndex& src, const GraphicsNode* n
-    ) -> bool {
-        return src.isValid()
-            && l.size() > src.row()
-            && n->index() == src.parent()
-            && l[src.row()];
-    };
+    if ((!srcIdx.isValid()) || srcIdx.model() != d_ptr->q_ptr)
+        return {};
+
+    // Only the sockets of this node are in the mapping
+    const auto i = srcIdx.column() ? srcIdx.sibling(srcIdx.row(), 0) : srcIdx;
+
+    int row = -1;
 
     switch (m_Type) {
         case GraphicsNodeSocket::SocketType::SOURCE:
-            if (check(m_pWrapper->m_lSourcesFromSrc, srcIdx, &m_pWrapper->m_Node))
-                return createIndex(m_pWrapper->m_lSourcesFromSrc[srcIdx.row()] - 1, 0, Q_NULLPTR);
+            row = m_pWrapper->m_hSourcesFromSrc.value(i, -1);
             break;
         case GraphicsNodeSocket::SocketType::SINK:
-            if (check(m_pWrapper->m_lSinksFromSrc, srcIdx, &m_pWrapper->m_Node))
-                return createIndex(m_pWrapper->m_lSinksFromSrc[srcIdx.row()] - 1, 0, Q_NULLPTR);
+            row = m_pWrapper->m_hSinksFromSrc.value(i, -1);
             break;
     }
 
-    return {};
+    return row == -1 ? QModelIndex() : createIndex(row, 0, Q_NULLPTR);
 }
 
 QModelIndex QNodeEdgeFilterProxy::mapToSource(const QModelIndex& proxyIndex) const
@@ -950,13 +1679,17 @@ QModelIndex QNodeEdgeFilterProxy::mapToSource(const QModelIndex& proxyIndex) con
     if (proxyIndex.column())
         return {};
 
-    const auto srcP = m_pWrapper->m_Node.index();
+    const int row = proxyIndex.row();
 
     switch (m_Type) {
         case GraphicsNodeSocket::SocketType::SOURCE:
-            return d_ptr->q_ptr->index(m_pWrapper->m_lSourcesToSrc[proxyIndex.row()], 0, srcP);
+            if (row < m_pWrapper->m_lSources.size())
+                return m_pWrapper->m_lSources[row]->m_Socket.index();
+            break;
         case GraphicsNodeSocket::SocketType::SINK:
-            return d_ptr->q_ptr->index(m_pWrapper->m_lSinksToSrc[proxyIndex.row()], 0, srcP);
+            if (row < m_pWrapper->m_lSinks.size())
+                return m_pWrapper->m_lSinks[row]->m_Socket.index();
+            break;
     }
 
     return {};
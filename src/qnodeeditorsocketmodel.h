@@ -2,6 +2,10 @@
 
 #include "qtypecoloriserproxy.h"
 #include <QtCore/QIdentityProxyModel>
+#include <QtCore/QLineF>
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+#include <QtCore/QPair>
 
 #include <graphicsnodesocket.hpp>
 
@@ -11,6 +15,7 @@ class GraphicsNodeScene;
 class GraphicsDirectedEdge;
 
 class QNodeEditorSocketModelPrivate;
+struct SceneSnapshot;
 
 //TODO move to a subclass
 class QNodeEditorEdgeModel : public QIdentityProxyModel
@@ -30,6 +35,12 @@ public:
 
     QNodeEditorSocketModel* socketModel() const;
 
+    /**
+     * The (source node row, sink node row) of every connection between two
+     * different nodes, without duplicates.
+     */
+    QVector< QPair<int, int> > nodeConnections() const;
+
 private:
     QNodeEditorSocketModelPrivate* d_ptr;
 };
@@ -43,6 +54,10 @@ private:
  * messy. Having a central entity to do it ensure a clear and simple ownership
  * pyramid for each objects.
  *
+ * Every row below a node becomes a socket, including the rows nested in
+ * tree sources (such as grouped properties). The nested sockets are laid
+ * out depth first after their parent and indented by their depth.
+ *
  * TODO once the model refactoring is done, turn into a private class
  */
 class QNodeEditorSocketModel : public QTypeColoriserProxy
@@ -50,6 +65,11 @@ class QNodeEditorSocketModel : public QTypeColoriserProxy
     Q_OBJECT
 public:
 
+    enum class EdgeStyle {
+        BEZIER    , /*!< Cubic curve between the sockets (default)       */
+        ORTHOGONAL, /*!< Routed around the nodes, computed on a thread  */
+    };
+
     explicit QNodeEditorSocketModel(
         QReactiveProxyModel* rmodel,
         GraphicsNodeScene* scene
@@ -57,6 +77,7 @@ public:
 
     virtual ~QNodeEditorSocketModel();
 
+    virtual QVariant data(const QModelIndex& idx, int role) const override;
     virtual bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
     virtual void setSourceModel(QAbstractItemModel *sourceModel) override;
     virtual QMimeData *mimeData(const QModelIndexList &indexes) const override;
@@ -79,6 +100,62 @@ public:
     Q_INVOKABLE QAbstractItemModel *sinkSocketModel(const QModelIndex& node) const;
     Q_INVOKABLE QAbstractItemModel *sourceSocketModel(const QModelIndex& node) const;
 
+    /**
+     * When virtualized, only the nodes intersecting the realized area have
+     * graphics items. The others are kept as plain records until they are
+     * scrolled into view. This is enabled by default.
+     */
+    bool isVirtualized() const;
+    void setVirtualized(bool value);
+
+    /**
+     * When the reactive model source is a QMultiModelTree, read the data of
+     * the sockets directly from their model instead of going through each
+     * proxy. Only the colours are still resolved by this model. This is
+     * disabled by default.
+     */
+    bool isFused() const;
+    void setFused(bool value);
+
+    /**
+     * Between those calls, moving nodes only updates their records. The edges,
+     * the realized items and the views are updated once at the end, with a
+     * single dataChanged. The calls can be nested.
+     */
+    void beginBatchUpdate();
+    void endBatchUpdate();
+
+    /**
+     * Set the scene area in which the nodes need to be realized. Usually
+     * the visible area plus some margin to hide the latency.
+     */
+    void setRealizedArea(const QRectF& area);
+
+    /**
+     * Hide the node and edge graphics items, for when the view draws an
+     * aggregated overview instead. The nodes are not realized while hidden.
+     */
+    bool areDetailedItemsVisible() const;
+    void setDetailedItemsVisible(bool value);
+
+    /**
+     * Fill the arrays with the scene rect of every node and a straight line
+     * for every connected edge.
+     */
+    void overviewGeometry(QVector<QRectF>& nodes, QVector<QLineF>& edges) const;
+
+    EdgeStyle edgeStyle() const;
+    void setEdgeStyle(EdgeStyle style);
+
+    /// Union of all node rects, including the unrealized ones
+    QRectF nodesBoundingRect() const;
+
+    /**
+     * Copy the geometry and style of everything intersecting area so it can
+     * be painted outside of the GUI thread.
+     */
+    void snapshot(SceneSnapshot& s, const QRectF& area) const;
+
     //TODO in later iterations of the API, add partial connections to the QNodeEditorEdgeModel
     GraphicsDirectedEdge* initiateConnectionFromSource(const QModelIndex& index, const QPointF& point);
     GraphicsDirectedEdge* initiateConnectionFromSink(const QModelIndex& index, const QPointF& point);
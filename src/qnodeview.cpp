@@ -10,6 +10,8 @@
 
 #include "qnodeeditorsocketmodel.h"
 
+#include "graphicsnodeexport_p.h"
+
 class QNodeViewPrivate final : public QObject
 {
 public:
@@ -81,3 +83,25 @@ QAbstractItemModel* QNodeView::edgeModel() const
 {
     return d_ptr->m_pFactory->edgeModel();
 }
+
+QImage QNodeView::renderToImage(qreal scale, const QRectF& area) const
+{
+    static const qreal margin = 20.0;
+
+    const QRectF rect = area.isNull() ?
+        d_ptr->m_pFactory->nodesBoundingRect().adjusted(-margin, -margin, margin, margin) : area;
+
+    SceneSnapshot s;
+    d_ptr->m_Scene.snapshot(s, scale, rect);
+
+    d_ptr->m_pFactory->snapshot(s, rect);
+
+    return GraphicsNodeExport::render(s, rect, scale);
+}
+
+bool QNodeView::exportImage(const QString& path, qreal scale, const QRectF& area) const
+{
+    const QImage img = renderToImage(scale, area);
+
+    return (!img.isNull()) && img.save(path);
+}
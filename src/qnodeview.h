@@ -2,6 +2,8 @@
 
 #include "graphicsnodeview.hpp"
 
+#include <QtGui/QImage>
+
 class QAbstractItemModel;
 class GraphicsNodeScene;
 class QReactiveProxyModel;
@@ -31,6 +33,18 @@ public:
 
     QAbstractItemModel* edgeModel() const;
 
+    /**
+     * Render the scene offscreen, this doesn't need the view to be shown.
+     *
+     * The nodes and edges are copied first, then the image is painted as
+     * tiles on the global QThreadPool. By default, the whole graph is
+     * rendered. A null image is returned if it would be too large.
+     */
+    QImage renderToImage(qreal scale = 1.0, const QRectF& area = {}) const;
+
+    /// Same as renderToImage, the format is deduced from the file suffix
+    bool exportImage(const QString& path, qreal scale = 1.0, const QRectF& area = {}) const;
+
 private:
     QNodeViewPrivate* d_ptr;
     Q_DECLARE_PRIVATE(QNodeView)
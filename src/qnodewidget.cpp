@@ -4,6 +4,7 @@
 #include "qmultimodeltree.h"
 
 #include "qreactiveproxymodel.h"
+#include "qnodeeditorsocketmodel.h"
 
 #include <QtCore/QDebug>
 
@@ -29,6 +30,9 @@ QNodeWidget::QNodeWidget(QWidget* parent) : QNodeView(parent),
 
     setModel(&d_ptr->m_Model);
 
+    // Nothing is stacked between the socket model and the tree
+    m_pModel->setFused(true);
+
     connect(reactiveModel(), &QAbstractItemModel::rowsAboutToBeRemoved,
         d_ptr, &QNodeWidgetPrivate::slotRemoveRows);
 
@@ -47,10 +51,22 @@ QNodeWidget::~QNodeWidget()
  */
 GraphicsNode* QNodeWidget::addObject(QObject* o, const QString& title, QNodeWidget::ObjectFlags f, const QVariant& uid)
 {
-    Q_UNUSED(f)
     d_ptr->q_ptr = this;
 
-    auto m = new QObjectModel({o}, Qt::Vertical, QObjectModel::Role::PropertyNameRole, this);
+    // The methods are not supported by QObjectModel yet
+    const int filter = static_cast<int>(f) & (
+        QObjectModel::USER_PROPERTIES    | QObjectModel::DESIGNABLE_PROPERTIES |
+        QObjectModel::CLASS_PROPERTIES   | QObjectModel::INHERITED_PROPERTIES
+    );
+
+    auto m = new QObjectModel(this);
+    m->setOrientation(Qt::Vertical);
+    m->setDisplayRole(QObjectModel::Role::PropertyNameRole);
+    m->setValueCached(true);
+    m->setPropertyFilter(filter ?
+        QObjectModel::PropertyFilter(filter) : QObjectModel::USER_PROPERTIES
+    );
+    m->addObject(o);
 
     return addModel(m, title, uid);
 }
@@ -73,11 +89,6 @@ GraphicsNode* QNodeWidget::addObject(QObject* o, const QString& title, QNodeWidg
  *     * Qt::DecorationRole for the socket icon
  *     * Qt::ForegroundRole for the label color
  *
- * Also note that mimeData() need to include the `application/x-qabstractitemmodeldatalist`
- * MIME type. For models that re-implement it, make sure to use the QMimeData*
- * returned from QAbstractItemModel::mimeData() as a base instead of creating
- * a blank one.
- *
  * Also note that you can set the model parent to the QNodeWidget to have it
  * deleted automatically when it is removed from the model.
  */
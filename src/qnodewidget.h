@@ -13,6 +13,10 @@ class Q_DECL_EXPORT QNodeWidget : public QNodeView
 {
     Q_OBJECT
 public:
+    /**
+     * The *_PROPERTIES flags have the same meaning as
+     * QObjectModel::PropertyFilter. The methods are not supported yet.
+     */
     enum class ObjectFlags {
         NONE                  = 0,
         USER_PROPERTIES       = 1 << 0,
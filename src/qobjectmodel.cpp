@@ -2,6 +2,13 @@
 
 #include <QtCore/QMetaProperty>
 #include <QtCore/QDebug>
+#include <QtCore/QHash>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QTimer>
+
+#include <algorithm>
 
 #if QT_VERSION < 0x050700
 //Q_FOREACH is deprecated and Qt CoW containers are detached on C++11 for loops
@@ -14,93 +21,163 @@ const T& qAsConst(const T& v)
 
 struct InternalItem;
 
-// The reason why this isn't part of InternalItem is to reduce the number of
-// cache fault when displaying the model. It isn't possible to mix generic
-// QMetaMethod based connections with lambdas. Obviously, doing it this way
-// can potentially create many, many QObjects.
-//
-// One future optimization would be to have many slots per objects and keep
-// an internal mapping back to the right InternalItem.
-//
-// Another one would be to re-implement the low level signal emit catcher
-// and avoid all the QObject::connect.
-class PropertyChangeReceiver : public QObject
-{
-    Q_OBJECT
+// The roles affected when a property value changes
+static const QVector<int>& valueRoles()
+{
+    static const QVector<int> roles {
+        Qt::DisplayRole, Qt::EditRole, QObjectModel::Role::ValueRole
+    };
+    return roles;
+}
+
+// It isn't possible to mix generic QMetaMethod based connections with
+// lambdas and creating a QObject per property per object doesn't scale. So
+// all notify signals are connected to this single receiver. It has no slots,
+// but it overrides qt_metacall and each (sender, signal) pair is connected
+// to a different (virtual) method index. That index is then used to look up
+// the items to update.
+class PropertyChangeReceiver final : public QObject
+{
 public:
-    explicit PropertyChangeReceiver(QObjectModel* m, InternalItem* i, QObject* p, int sigIdx);
+    explicit PropertyChangeReceiver(QObjectModel* m) : QObject(m), m_pModel(m) {}
 
-    InternalItem* item;
-    QObjectModel* model;
+    void watch(InternalItem* item, int sigIdx);
 
-public Q_SLOTS:
-    void changed();
-    void slotDestroyed();
-};
+    int  interval() const;
+    void setInterval(int ms);
 
+    virtual int qt_metacall(QMetaObject::Call call, int id, void** args) override;
 
-class PropertyChangeReceiverFactory
-{
-    static PropertyChangeReceiver* connectForId(InternalItem* item, int id);
 private:
-    static QHash<int, PropertyChangeReceiver*> m_hReceivers;
-};
+    struct Entry {
+        QObject*               m_pSender     {nullptr};
+        int                    m_SignalIndex {-1};
+        QVector<InternalItem*> m_lItems      {};
+    };
+
+    QObjectModel* m_pModel;
 
-QHash<int, PropertyChangeReceiver*> PropertyChangeReceiverFactory::m_hReceivers;
+    // The position in m_lEntries is the virtual method index
+    QVector<Entry> m_lEntries;
+    QVector<int>   m_lFreeEntries;
 
+    QHash<QPair<QObject*, int>, int> m_hEntries;
+    QHash<QObject*, QVector<int>>    m_hObjectEntries;
+
+    // Throttling
+    QTimer*                m_pTimer {nullptr};
+    QVector<InternalItem*> m_lPending;
+
+    // Helpers
+    int connectEntry(QObject* sender, int sigIdx);
+    void release(QObject* sender);
+    void flush();
+};
+
+// Immutable once published by MetaPropertyCache, so it can be shared by
+// all models across all threads.
 struct MetaPropertyColumnMapper
 {
     struct Property {
-        const uchar      flags;
-        const int        index;
-        const int        metaType;
-        const QByteArray name;
-        int              sigIdx;
+        uchar         flags;
+        int           index;
+        int           metaType;
+        QByteArray    name;
+        QByteArray    typeName;
+        int           sigIdx;
+        QMetaProperty meta;
     };
 
     const QMetaObject* m_pMetaObject;
-    QVector<Property*> m_lProperties {};
+    QVector<Property>  m_lProperties {}; // contiguous
 
 private:
-    friend class QObjectModelPrivate;
+    friend class MetaPropertyCache;
     explicit MetaPropertyColumnMapper(const QMetaObject* m) : m_pMetaObject(m){}
 };
 
+/**
+ * Process wide cache of the introspected classes.
+ *
+ * The lookups are lock free. The table is never modified once published, a
+ * miss publishes a modified copy instead. There are few classes and each is
+ * introspected once, so the copies are cheap. The old tables are kept alive
+ * since other threads may still be reading them.
+ */
+class MetaPropertyCache final
+{
+public:
+    ~MetaPropertyCache();
+
+    static MetaPropertyCache* instance();
+
+    const MetaPropertyColumnMapper* get(const QMetaObject* m, QObjectModel::PropertyFilter f);
+
+private:
+    typedef QPair<const QMetaObject*, int> Key;
+    typedef QHash<Key, const MetaPropertyColumnMapper*> Table;
+
+    QAtomicPointer<const Table> m_pTable {nullptr};
+
+    // Only for the writers
+    QMutex                m_Mutex;
+    QVector<const Table*> m_lRetired;
+
+    static MetaPropertyColumnMapper* introspect(const QMetaObject* m, QObjectModel::PropertyFilter f);
+};
+
 struct InternalItem
 {
     int           m_Index;
     QObject*      m_pObject;
     bool          m_IsObjectRoot;
     QObjectModel* m_pModel;
-    MetaPropertyColumnMapper::Property *m_pProp;
-    QVector<InternalItem*> m_lColumns;
+    const MetaPropertyColumnMapper* m_pMapper;
+    const MetaPropertyColumnMapper::Property* m_pProp;
+
+    // Only used when QObjectModel::isValueCached()
+    QVariant m_Value;
+    bool     m_IsCached;
+
+    // Waiting for the next throttled dataChanged
+    bool     m_IsPending;
 
+    // The properties of an object are contiguous, starting with the root
     InternalItem* getChild(int id) {
-        return id ? m_lColumns[id] : this;
+        return this + id;
+    }
+
+    int columnCount() const {
+        return m_IsObjectRoot ? m_pMapper->m_lProperties.size() : 0;
     }
 };
 
 class QObjectModelPrivate final
 {
 public:
+    PropertyChangeReceiver* m_pReceiver;
     bool m_IsHeterogeneous {false};
     bool m_IsVertical      {false};
     bool m_IsReadOnly      {false};
+    bool m_IsValueCached   {false};
     int  m_DisplayRole     {Qt::DisplayRole};
+    QObjectModel::PropertyFilter m_Filter {QObjectModel::USER_PROPERTIES};
     QVector<InternalItem*> m_lRows;
-    static QHash<const QMetaObject*, MetaPropertyColumnMapper*> m_hMapper;
+
+    // The items are allocated in blocks, one per addObjects() call
+    QVector<InternalItem*> m_lArenas;
+
 
     // Helpers
     void clear();
     void regen();
-    static MetaPropertyColumnMapper* getMapper(QObject*);
+    QVariant read(InternalItem* item) const;
 };
 
-QHash<const QMetaObject*, MetaPropertyColumnMapper*> QObjectModelPrivate::m_hMapper;
-
 QObjectModel::QObjectModel(QObject* parent) : QAbstractItemModel(parent),
 d_ptr(new QObjectModelPrivate)
 {
+    d_ptr->m_pReceiver = new PropertyChangeReceiver(this);
 }
 
 QObjectModel::QObjectModel(const QList<QObject*> objs, Qt::Orientation o, int dr, QObject* p) :
@@ -146,7 +223,7 @@ QVariant QObjectModel::data(const QModelIndex& idx, int role) const
         case Qt::EditRole:
             [[clang::fallthrough]];
         case Role::ValueRole:
-            return item->m_pObject->property(item->m_pProp->name);
+            return d_ptr->read(item);
         case Role::PropertyIdRole:
             return item->m_pProp->index;
         case Role::CapabilitiesRole:
@@ -154,7 +231,7 @@ QVariant QObjectModel::data(const QModelIndex& idx, int role) const
         case Role::MetaTypeRole:
             return item->m_pProp->metaType;
         case Role::TypeNameRole:
-            return QStringLiteral("TODO");
+            return item->m_pProp->typeName;
         case Role::PropertyNameRole:
             return item->m_pProp->name;
     }
@@ -174,8 +251,10 @@ bool QObjectModel::setData(const QModelIndex &index, const QVariant &value, int
         return false;
 
 
-    item->m_pObject->setProperty(item->m_pProp->name, value);
-    return true;
+    // The notify signal might not be emitted if the value is the same
+    item->m_IsCached = false;
+
+    return item->m_pProp->meta.write(item->m_pObject, value);
 }
 
 int QObjectModel::rowCount(const QModelIndex& parent) const
@@ -186,7 +265,7 @@ int QObjectModel::rowCount(const QModelIndex& parent) const
 int QObjectModel::columnCount(const QModelIndex& parent) const
 {
     return (parent.isValid() || !d_ptr->m_lRows.size()) ?
-        0 : d_ptr->m_lRows[0]->m_lColumns.size();
+        0 : d_ptr->m_lRows[0]->columnCount();
 }
 
 QModelIndex QObjectModel::index(int row, int column, const QModelIndex& parent) const
@@ -195,7 +274,7 @@ QModelIndex QObjectModel::index(int row, int column, const QModelIndex& parent)
         return {};
 
     if (row < d_ptr->m_lRows.size() && (
-      column == 0 || column <= d_ptr->m_lRows[row]->m_lColumns.size()-1)
+      column == 0 || column <= d_ptr->m_lRows[row]->columnCount()-1)
     )
         return createIndex(row, column, d_ptr->m_lRows[row]->getChild(column));
 
@@ -270,7 +349,53 @@ int QObjectModel::displayRole() const
 void QObjectModel::setDisplayRole(int role)
 {
     d_ptr->m_DisplayRole = role;
-    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount() -1));
+
+    if (!rowCount())
+        return;
+
+    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount() -1), {Qt::DisplayRole});
+}
+
+bool QObjectModel::isValueCached() const
+{
+    return d_ptr->m_IsValueCached;
+}
+
+void QObjectModel::setValueCached(bool value)
+{
+    d_ptr->m_IsValueCached = value;
+
+    if (!value) {
+        for (auto i : qAsConst(d_ptr->m_lRows)) {
+            for (int c = 0; c < i->columnCount(); c++) {
+                i->getChild(c)->m_IsCached = false;
+                i->getChild(c)->m_Value    = {};
+            }
+
+            i->m_IsCached = false;
+            i->m_Value    = {};
+        }
+    }
+}
+
+int QObjectModel::notificationInterval() const
+{
+    return d_ptr->m_pReceiver->interval();
+}
+
+void QObjectModel::setNotificationInterval(int ms)
+{
+    d_ptr->m_pReceiver->setInterval(ms);
+}
+
+QObjectModel::PropertyFilter QObjectModel::propertyFilter() const
+{
+    return d_ptr->m_Filter;
+}
+
+void QObjectModel::setPropertyFilter(PropertyFilter f)
+{
+    d_ptr->m_Filter = f;
 }
 
 bool QObjectModel::isReadOnly() const
@@ -283,69 +408,91 @@ void QObjectModel::setReadOnly(bool value)
     //const bool changed = value != d_ptr->m_IsReadOnly;
     d_ptr->m_IsReadOnly = value;
 
-    // Emit dataChanged so the ::flags() method is called by the view
-    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount() -1));
+    if (!rowCount())
+        return;
+
+    // Emit dataChanged so the ::flags() method is called by the view. The
+    // flags have no role, the capabilities are the closest.
+    Q_EMIT dataChanged(
+        index(0,0), index(rowCount()-1, columnCount() -1), {Role::CapabilitiesRole}
+    );
 }
 
 void QObjectModel::addObject(QObject* obj)
 {
-    if (!obj) return;
+    addObjects(QVector<QObject*> {obj});
+}
 
-    auto mapper = d_ptr->getMapper(obj);
+void QObjectModel::addObjects(const QVector<QObject*>& objs)
+{
+    // Resolve the mappers first, the batch size has to be known beforehand
+    QVector<QPair<QObject*, const MetaPropertyColumnMapper*>> batch;
+    batch.reserve(objs.size());
 
-    if (mapper->m_lProperties.isEmpty()) return;
+    int total = 0;
 
-    beginInsertRows({}, d_ptr->m_lRows.size(), d_ptr->m_lRows.size());
-    auto item = new InternalItem {
-        d_ptr->m_lRows.size(),
-        obj,
-        true,
-        this,
-        mapper->m_lProperties[0],
-        {}
-    };
-    endInsertRows();
+    for (auto o : qAsConst(objs)) {
+        if (!o) continue;
+
+        auto mapper = MetaPropertyCache::instance()->get(o->metaObject(), d_ptr->m_Filter);
+
+        if (mapper->m_lProperties.isEmpty()) continue;
 
-    if (!d_ptr->m_IsVertical)
-        d_ptr->m_lRows << item;
-
-    auto list = d_ptr->m_IsVertical ? &d_ptr->m_lRows : &item->m_lColumns;
-
-    beginInsertRows({}, list->size(), list->size()+mapper->m_lProperties.size()-2); //FIXME support columns
-    for (auto p : qAsConst(mapper->m_lProperties)) {
-        // Add the existing item to its own column to simplify the code elsewhere
-        auto ip = ((p==item->m_pProp) ? item : new InternalItem {
-            d_ptr->m_lRows.size(), //FIXME this doesn't support columns
-            obj,
-            false,
-            this,
-            p,
-            {}
-        });
-        (*list) << ip;
-
-        // The notify signal could be anything. It doesn't have to have an argument
-        // with the same QMetaType as the property. Even if it has, there is no way
-        // to know if it matches the property without trying to get it. So better
-        // just assume the arguments is irrelevant and use the getter. Note that it
-        // could be done using a custom qt_static_metacall, but again, it is a
-        // little pointless to implement.
-        if (p->sigIdx >= 0)
-            new PropertyChangeReceiver(this, ip, obj, p->sigIdx);
+        batch << qMakePair(o, mapper);
+        total += mapper->m_lProperties.size();
     }
+
+    if (batch.isEmpty()) return;
+
+    // All items of the batch are in a single allocation. Each object is a
+    // root item followed by its other properties.
+    auto arena = new InternalItem[total]();
+    d_ptr->m_lArenas << arena;
+
+    const int first = d_ptr->m_lRows.size();
+    const int count = d_ptr->m_IsVertical ? total : batch.size();
+
+    beginInsertRows({}, first, first + count - 1); //FIXME support columns
+
+    d_ptr->m_lRows.reserve(first + count);
+
+    InternalItem* item = arena;
+
+    for (const auto& pair : qAsConst(batch)) {
+        const auto  mapper = pair.second;
+        const auto& props  = mapper->m_lProperties;
+        const int   row    = d_ptr->m_lRows.size();
+
+        for (int i = 0; i < props.size(); i++) {
+            item[i].m_Index        = d_ptr->m_IsVertical ? row + i : row; //FIXME this doesn't support columns
+            item[i].m_pObject      = pair.first;
+            item[i].m_IsObjectRoot = i == 0;
+            item[i].m_pModel       = this;
+            item[i].m_pMapper      = mapper;
+            item[i].m_pProp        = &props[i];
+
+            if (d_ptr->m_IsVertical || !i)
+                d_ptr->m_lRows << &item[i];
+        }
+
+        item += props.size();
+    }
+
     endInsertRows();
-}
 
-void QObjectModel::addObjects(const QVector<QObject*>& objs)
-{
-    for (auto o : qAsConst(objs))
-        addObject(o);
+    // The notify signal could be anything. It doesn't have to have an argument
+    // with the same QMetaType as the property. Even if it has, there is no way
+    // to know if it matches the property without trying to get it. So better
+    // just assume the arguments is irrelevant and use the getter.
+    for (int i = 0; i < total; i++) {
+        if (arena[i].m_pProp->sigIdx >= 0)
+            d_ptr->m_pReceiver->watch(&arena[i], arena[i].m_pProp->sigIdx);
+    }
 }
 
 void QObjectModel::addObjects(const QList<QObject*>& objs)
 {
-    for (auto o : qAsConst(objs))
-        addObject(o);
+    addObjects(objs.toVector());
 }
 
 QObject* QObjectModel::getObject(const QModelIndex& idx) const
@@ -368,18 +515,10 @@ int QObjectModel::objectCount() const
 
 void QObjectModelPrivate::clear()
 {
-    QList<InternalItem*> items;
-
-    for (auto i : qAsConst(m_lRows))
-        if (i->m_IsObjectRoot)
-            items << i;
-
-    for (auto i : qAsConst(items)) {
-        if (i->m_lColumns.size())
-            for (auto ii : qAsConst(i->m_lColumns)) delete ii;
-        delete i;
-    }
+    for (auto a : qAsConst(m_lArenas))
+        delete[] a;
 
+    m_lArenas.clear();
     m_lRows.clear();
 }
 
@@ -390,30 +529,109 @@ void QObjectModelPrivate::regen()
     QList<InternalItem*> rootItems;
 
     for (auto i : qAsConst(m_lRows))
-        if (i->m_IsObjectRoot) {
-            i->m_Index = m_lRows.size();
+        if (i->m_IsObjectRoot)
             rootItems << i;
-        }
 
     m_lRows.clear();
 
     if (m_IsVertical) {
         for (auto i : qAsConst(rootItems))
-            for (auto ii : qAsConst(i->m_lColumns)) {
-                ii->m_Index = m_lRows.size();
-                m_lRows << ii;
+            for (int c = 0; c < i->columnCount(); c++) {
+                i->getChild(c)->m_Index = m_lRows.size();
+                m_lRows << i->getChild(c);
             }
-    } else
-        m_lRows = rootItems.toVector();
+    } else {
+        for (auto i : qAsConst(rootItems)) {
+            for (int c = 0; c < i->columnCount(); c++)
+                i->getChild(c)->m_Index = m_lRows.size();
+
+            m_lRows << i;
+        }
+    }
+}
+
+QVariant QObjectModelPrivate::read(InternalItem* item) const
+{
+    const auto prop = item->m_pProp;
+
+    // Without a notify signal, there is no way to know when it changes
+    typedef QObjectModel::Capabilities CAP;
+    const bool cacheable = m_IsValueCached && (prop->flags & (CAP::NOTIFY | CAP::CONST));
+
+    if (!cacheable)
+        return prop->meta.read(item->m_pObject);
+
+    if (!item->m_IsCached) {
+        item->m_Value    = prop->meta.read(item->m_pObject);
+        item->m_IsCached = true;
+    }
+
+    return item->m_Value;
+}
+
+MetaPropertyCache* MetaPropertyCache::instance()
+{
+    static MetaPropertyCache cache;
+    return &cache;
+}
+
+MetaPropertyCache::~MetaPropertyCache()
+{
+    if (auto t = m_pTable.loadAcquire()) {
+        for (auto m : *t)
+            delete m;
+
+        delete t;
+    }
+
+    for (auto t : qAsConst(m_lRetired))
+        delete t;
 }
 
-MetaPropertyColumnMapper* QObjectModelPrivate::getMapper(QObject* o)
+const MetaPropertyColumnMapper* MetaPropertyCache::get(const QMetaObject* m, QObjectModel::PropertyFilter f)
 {
-    const QMetaObject* m = o->metaObject();
-    auto mapper = m_hMapper[m];
-    if (mapper) return mapper;
+    const Key key(m, int(f));
+
+    if (auto t = m_pTable.loadAcquire()) {
+        const auto it = t->constFind(key);
+
+        if (it != t->constEnd())
+            return *it;
+    }
+
+    QMutexLocker l(&m_Mutex);
+
+    // Another thread might have added it in the meantime
+    const Table* old = m_pTable.loadAcquire();
 
-    mapper = new MetaPropertyColumnMapper(m);
+    if (old) {
+        const auto it = old->constFind(key);
+
+        if (it != old->constEnd())
+            return *it;
+    }
+
+    const auto mapper = introspect(m, f);
+
+    Table* t = old ? new Table(*old) : new Table;
+    t->insert(key, mapper);
+
+    m_pTable.storeRelease(t);
+
+    if (old)
+        m_lRetired << old;
+
+    return mapper;
+}
+
+MetaPropertyColumnMapper* MetaPropertyCache::introspect(const QMetaObject* m, QObjectModel::PropertyFilter f)
+{
+    typedef QObjectModel PF;
+
+    const bool anySource    = !(f & (PF::CLASS_PROPERTIES | PF::INHERITED_PROPERTIES));
+    const bool anyAttribute = !(f & (PF::USER_PROPERTIES  | PF::DESIGNABLE_PROPERTIES));
+
+    auto mapper = new MetaPropertyColumnMapper(m);
 
     // Usually, I prefer enum classes, but Qt doesn't have much magic for
     // them yet...
@@ -424,10 +642,21 @@ MetaPropertyColumnMapper* QObjectModelPrivate::getMapper(QObject* o)
     for (int i=0; i < pCount; i++) {
         const auto p = m->property(i);
 
-        if (!p.isUser()) //TODO remove this and add capability filters
+        const bool isOwn = i >= m->propertyOffset();
+
+        if (!(anySource || (f & (isOwn ? PF::CLASS_PROPERTIES : PF::INHERITED_PROPERTIES))))
+            continue;
+
+        if (!(anyAttribute
+          || ((f & PF::USER_PROPERTIES      ) && p.isUser      ())
+          || ((f & PF::DESIGNABLE_PROPERTIES) && p.isDesignable())))
+            continue;
+
+        if (((f & PF::WRITABLE_PROPERTIES) && !p.isWritable     ())
+          || ((f & PF::NOTIFY_PROPERTIES ) && !p.hasNotifySignal()))
             continue;
 
-        mapper->m_lProperties << new MetaPropertyColumnMapper::Property {
+        mapper->m_lProperties << MetaPropertyColumnMapper::Property {
             static_cast<unsigned char>(
                 (p.isReadable     () ? CAP::READ   : CAP::NONE) |
                 (p.isWritable     () ? CAP::WRITE  : CAP::NONE) |
@@ -438,43 +667,174 @@ MetaPropertyColumnMapper* QObjectModelPrivate::getMapper(QObject* o)
             p.propertyIndex(),
             p.userType(),
             p.name(),
-            p.notifySignalIndex()
+            p.typeName(),
+            p.notifySignalIndex(),
+            p
         };
     }
 
     return mapper;
 }
 
-// Setting the parent ensure the memory will be cleaned when `o` is destroyed.
-PropertyChangeReceiver::PropertyChangeReceiver(QObjectModel* m, InternalItem* i, QObject* p, int sigIdx)
-    : QObject(p), item(i), model(m)
+static int destroyedIndex()
 {
-    // Handle removing the item from this
-    if (i->m_IsObjectRoot)
-        connect(this, &QObject::destroyed,
-            this, &PropertyChangeReceiver::slotDestroyed);
+    static const int idx = QObject::staticMetaObject.indexOfSignal("destroyed(QObject*)");
+    return idx;
+}
 
-    connect(m, &QObject::destroyed, this, &QObject::deleteLater);
+int PropertyChangeReceiver::connectEntry(QObject* sender, int sigIdx)
+{
+    int id;
 
-    const auto notifySignal = p->metaObject()->method(sigIdx);
+    if (!m_lFreeEntries.isEmpty())
+        id = m_lFreeEntries.takeLast();
+    else {
+        id = m_lEntries.size();
+        m_lEntries.resize(id + 1);
+    }
 
-    static int changedId = metaObject()->indexOfSlot("changed()");
+    m_lEntries[id].m_pSender     = sender;
+    m_lEntries[id].m_SignalIndex = sigIdx;
 
-    const auto notifySlot = metaObject()->method(changedId);
+    m_hEntries[qMakePair(sender, sigIdx)] = id;
+    m_hObjectEntries[sender] << id;
 
-    QObject::connect(p, notifySignal, this, notifySlot);
+    // The receiver has no such method, it is handled by qt_metacall. The
+    // objects living in other threads get a queued connection, its argument
+    // types come from the signal.
+    QMetaObject::connect(sender, sigIdx, this,
+        QObject::staticMetaObject.methodCount() + id, Qt::AutoConnection
+    );
+
+    return id;
 }
 
-void PropertyChangeReceiver::changed()
+void PropertyChangeReceiver::watch(InternalItem* item, int sigIdx)
 {
-    const QModelIndex idx = model->createIndex(item->m_Index, 0, item); //FIXME this doesn't support columns
+    QObject* o = item->m_pObject;
+
+    // The connections are removed by QObject, but the entries have to be
+    // recycled
+    if (!m_hObjectEntries.contains(o))
+        connectEntry(o, destroyedIndex());
 
-    Q_EMIT model->dataChanged(idx, idx);
+    // Many properties often share the same notify signal
+    const auto key = qMakePair(o, sigIdx);
+    auto it = m_hEntries.constFind(key);
+
+    const int id = it == m_hEntries.constEnd() ?
+        connectEntry(o, sigIdx) : *it;
+
+    m_lEntries[id].m_lItems << item;
 }
 
-void PropertyChangeReceiver::slotDestroyed()
+void PropertyChangeReceiver::release(QObject* sender)
 {
+    const QVector<int> ids = m_hObjectEntries.take(sender);
+
+    for (const int id : ids) {
+        Entry& e = m_lEntries[id];
+        m_hEntries.remove(qMakePair(e.m_pSender, e.m_SignalIndex));
+        e = Entry();
+        m_lFreeEntries << id;
+    }
+
     //TODO emit the beginRemoveRows and delete the InternalItem
 }
 
-#include "qobjectmodel.moc"
+int PropertyChangeReceiver::qt_metacall(QMetaObject::Call call, int id, void** args)
+{
+    id = QObject::qt_metacall(call, id, args);
+
+    if (id < 0 || call != QMetaObject::InvokeMetaMethod)
+        return id;
+
+    Q_ASSERT(id < m_lEntries.size());
+
+    const Entry& e = m_lEntries[id];
+
+    if (e.m_SignalIndex == destroyedIndex()) {
+        release(e.m_pSender);
+        return -1;
+    }
+
+    // A copy, the slots connected to dataChanged could add more objects
+    const QVector<InternalItem*> items = e.m_lItems;
+
+    for (auto item : items) {
+        item->m_IsCached = false;
+
+        if (m_pTimer) {
+            if (!item->m_IsPending) {
+                item->m_IsPending = true;
+                m_lPending << item;
+            }
+
+            continue;
+        }
+
+        const QModelIndex idx = m_pModel->createIndex(item->m_Index, 0, item); //FIXME this doesn't support columns
+
+        Q_EMIT m_pModel->dataChanged(idx, idx, valueRoles());
+    }
+
+    if (m_pTimer && !m_lPending.isEmpty() && !m_pTimer->isActive())
+        m_pTimer->start();
+
+    return -1;
+}
+
+int PropertyChangeReceiver::interval() const
+{
+    return m_pTimer ? m_pTimer->interval() : 0;
+}
+
+void PropertyChangeReceiver::setInterval(int ms)
+{
+    if (ms <= 0) {
+        flush();
+        delete m_pTimer;
+        m_pTimer = nullptr;
+        return;
+    }
+
+    if (!m_pTimer) {
+        m_pTimer = new QTimer(this);
+        m_pTimer->setSingleShot(true);
+        QObject::connect(m_pTimer, &QTimer::timeout, this, [this]() { flush(); });
+    }
+
+    m_pTimer->setInterval(ms);
+}
+
+void PropertyChangeReceiver::flush()
+{
+    if (m_lPending.isEmpty())
+        return;
+
+    QVector<int> rows;
+    rows.reserve(m_lPending.size());
+
+    for (auto item : qAsConst(m_lPending)) {
+        item->m_IsPending = false;
+        rows << item->m_Index;
+    }
+
+    m_lPending.clear();
+
+    std::sort(rows.begin(), rows.end());
+
+    // One dataChanged per contiguous range
+    for (int i = 0; i < rows.size();) {
+        int j = i;
+
+        while (j + 1 < rows.size() && rows[j + 1] <= rows[j] + 1)
+            j++;
+
+        Q_EMIT m_pModel->dataChanged(
+            m_pModel->index(rows[i], 0), m_pModel->index(rows[j], 0), valueRoles()
+        );
+
+        i = j + 1;
+    }
+}
@@ -36,6 +36,28 @@ public:
         USER   = 1 << 4,
     };
 
+    /**
+     * Select the properties added to the model.
+     *
+     * The properties from the object class and/or its parent classes are
+     * selected first. If neither CLASS_PROPERTIES or INHERITED_PROPERTIES
+     * is set, both are used. If USER_PROPERTIES and/or DESIGNABLE_PROPERTIES
+     * are set, only the properties with one of those attributes are kept.
+     * The other flags are requirements.
+     *
+     * Each (class, filter) pair is introspected once and shared by all
+     * models.
+     */
+    enum PropertyFilterFlag {
+        USER_PROPERTIES       = 1 << 0,
+        DESIGNABLE_PROPERTIES = 1 << 1,
+        CLASS_PROPERTIES      = 1 << 2,
+        INHERITED_PROPERTIES  = 1 << 3,
+        WRITABLE_PROPERTIES   = 1 << 4,
+        NOTIFY_PROPERTIES     = 1 << 5,
+    };
+    Q_DECLARE_FLAGS(PropertyFilter, PropertyFilterFlag)
+
     enum Role {
         ValueRole = Qt::UserRole+1,
         PropertyIdRole,
@@ -65,6 +87,22 @@ public:
      */
     Q_PROPERTY(bool readOnly READ isReadOnly WRITE setReadOnly)
 
+    /**
+     * Keep the value of the properties with a notify signal (or constant)
+     * until it is emitted instead of reading the property for each data()
+     * call. This is disabled by default since it assumes the notify signals
+     * are reliable.
+     */
+    Q_PROPERTY(bool valueCached READ isValueCached WRITE setValueCached)
+
+    /**
+     * The minimum time, in milliseconds, between two dataChanged caused by
+     * the notify signals. The changes received in the meantime are merged
+     * into contiguous row ranges. The default (0) emits them immediately,
+     * 16 would limit it to about one update per frame.
+     */
+    Q_PROPERTY(int notificationInterval READ notificationInterval WRITE setNotificationInterval)
+
     explicit QObjectModel(QObject* parent = Q_NULLPTR);
     QObjectModel(const QList<QObject*> objs, Qt::Orientation = Qt::Horizontal, int displayRole = Qt::DisplayRole, QObject* parent = Q_NULLPTR);
     virtual ~QObjectModel();
@@ -88,6 +126,16 @@ public:
     int displayRole() const;
     void setDisplayRole(int role);
 
+    bool isValueCached() const;
+    void setValueCached(bool value);
+
+    int notificationInterval() const;
+    void setNotificationInterval(int ms);
+
+    /// Only affects the objects added after it is set (USER_PROPERTIES by default)
+    PropertyFilter propertyFilter() const;
+    void setPropertyFilter(PropertyFilter f);
+
     int objectCount() const;
 
     Q_INVOKABLE QObject* getObject(const QModelIndex& idx) const;
@@ -97,6 +145,9 @@ public:
 
     /**
      * Add objects to be displayed in the model.
+     *
+     * Each call inserts all the rows at once, prefer adding many objects
+     * in one call over many addObject().
      */
     Q_INVOKABLE void addObject(QObject* obj);
     Q_INVOKABLE void addObjects(const QVector<QObject*>& objs);
@@ -107,5 +158,6 @@ private:
     Q_DECLARE_PRIVATE(QObjectModel)
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(QObjectModel::PropertyFilter)
 Q_FLAGS(QObjectModel::Capabilities)
 Q_ENUMS(QObjectModel::Role)
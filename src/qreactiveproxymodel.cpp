@@ -5,7 +5,8 @@
 #include <QtCore/QMimeData>
 #include <QtCore/QDebug>
 
-#include "qmodeldatalistdecoder.h"
+#include <algorithm>
+#include <cstring>
 
 #if QT_VERSION < 0x050700
 //Q_FOREACH is deprecated and Qt CoW containers are detached on C++11 for loops
@@ -38,8 +39,6 @@ struct ConnectionHolder
 
     QPersistentModelIndex source;
     QPersistentModelIndex destination;
-    void* sourceIP;
-    void* destinationIP;
 
     bool isValid() const {
         return source.isValid() && destination.isValid();
@@ -50,13 +49,32 @@ struct ConnectionHolder
     }
 };
 
+/**
+ * The MIME payload of a dragged connection source.
+ *
+ * It only identifies the source and its type, so encoding and decoding are
+ * a copy and don't depend on the value. The source is looked up by serial
+ * in the drags issued by the model, nothing in the payload is dereferenced.
+ * It is only meaningful within this process.
+ */
+struct ConnectionPayload
+{
+    enum { VERSION = 2 };
+
+    quint32  version;
+    quint32  metaType;
+    quint32  flags;
+    quint32  padding;
+    quint64  serial;
+    quint64  model;
+};
+
 class QReactiveProxyModelPrivate : public QObject
 {
 public:
-    const QString MIME_TYPE = QStringLiteral("qt-model/reactive-connection");
+    const QString MIME_TYPE = QStringLiteral("qt-model/reactive-connection"); // see decodePayload()
     QVector<int> m_lConnectedRoles;
     ConnectedIndicesModel* m_pConnectionModel;
-    QHash<const QMimeData*, QPersistentModelIndex> m_hDraggedIndexCache;
     QVector<ConnectionHolder*> m_lConnections;
 
     QAbstractProxyModel* m_pCurrentProxy {nullptr};
@@ -65,13 +83,25 @@ public:
     int  m_ExtraRole   [5] {0,     0,     0,     0,     0    };
 
     // In case dataChanged() contains a single QModelIndex, use this fast path
-    // to avoid doing a query on each connections or QModelIndex
-    QHash<void*, ConnectionHolder*> m_hDirectMapping;
+    // to avoid doing a query on each connections or QModelIndex. Both ends
+    // are indexed. The keys are plain indices, they are rebuilt from the
+    // persistent ones when the structure changes.
+    QHash<QModelIndex, QVector<ConnectionHolder*>> m_hDirectMapping;
+
+    // The sources of the QMimeData being dragged, removed when they are
+    // destroyed
+    QHash<quint64, QPersistentModelIndex> m_hDragged;
+    quint64 m_DragSerial {0};
 
     //Helper
     void clear();
     bool synchronize(const QModelIndex& source, const QModelIndex& destination) const;
     ConnectionHolder* newConnection();
+    void link(ConnectionHolder* conn, const QModelIndex& idx);
+    void unlink(ConnectionHolder* conn, const QModelIndex& idx);
+    QModelIndex toLocal(const QModelIndex& idx) const;
+    bool decode(const QMimeData* data, ConnectionPayload& p) const;
+    QModelIndex sourceIndex(const ConnectionPayload& p) const;
 
     void notifyConnect(const QModelIndex& source, const QModelIndex& destination) const;
     void notifyDisconnect(const QModelIndex& source, const QModelIndex& destination) const;
@@ -80,9 +110,10 @@ public:
 
     QReactiveProxyModel* q_ptr;
 public Q_SLOTS:
-    void slotMimeDestroyed();
-    void slotDataChanged(const QModelIndex& tl, const QModelIndex& br);
+    void slotDataChanged(const QModelIndex& tl, const QModelIndex& br,
+                         const QVector<int>& roles = {});
     void slotRemoveItem(const QModelIndex &parent, int first, int last);
+    void slotRebuildMapping();
 };
 
 QReactiveProxyModel::QReactiveProxyModel(QObject* parent) : QIdentityProxyModel(parent),
@@ -95,6 +126,18 @@ QReactiveProxyModel::QReactiveProxyModel(QObject* parent) : QIdentityProxyModel(
         d_ptr, &QReactiveProxyModelPrivate::slotDataChanged);
     connect(this, &QAbstractItemModel::rowsAboutToBeRemoved,
         d_ptr, &QReactiveProxyModelPrivate::slotRemoveItem);
+
+    // The rows of the mapping keys may have changed
+    connect(this, &QAbstractItemModel::rowsInserted,
+        d_ptr, &QReactiveProxyModelPrivate::slotRebuildMapping);
+    connect(this, &QAbstractItemModel::rowsRemoved,
+        d_ptr, &QReactiveProxyModelPrivate::slotRebuildMapping);
+    connect(this, &QAbstractItemModel::rowsMoved,
+        d_ptr, &QReactiveProxyModelPrivate::slotRebuildMapping);
+    connect(this, &QAbstractItemModel::layoutChanged,
+        d_ptr, &QReactiveProxyModelPrivate::slotRebuildMapping);
+    connect(this, &QAbstractItemModel::modelReset,
+        d_ptr, &QReactiveProxyModelPrivate::slotRebuildMapping);
 }
 
 ConnectedIndicesModel::ConnectedIndicesModel(QObject* parent, QReactiveProxyModelPrivate* d)
@@ -115,23 +158,72 @@ QMimeData* QReactiveProxyModel::mimeData(const QModelIndexList &indexes) const
 
     const auto idx = indexes.first();
 
-    if (!idx.isValid())
+    if ((!idx.isValid()) || idx.model() != this)
         return Q_NULLPTR;
 
-    // Will also have whatever the source had and hopefully the
-    // `application/x-qabstractitemmodeldatalist` MIME type from
-    // QAbstractItemModel::mimeData()`
-    auto md = QIdentityProxyModel::mimeData(indexes);
+    const quint64 serial = ++d_ptr->m_DragSerial;
 
-    connect(md, &QObject::destroyed, d_ptr, &QReactiveProxyModelPrivate::slotMimeDestroyed);
+    // The value itself is never serialized, only the type
+    const ConnectionPayload p {
+        ConnectionPayload::VERSION,
+        quint32(idx.data(Qt::EditRole).userType()),
+        quint32(flags(idx)),
+        0,
+        serial,
+        quint64(reinterpret_cast<quintptr>(this))
+    };
 
-    d_ptr->m_hDraggedIndexCache[md] = idx;
+    auto md = new QMimeData();
 
-    md->setData(d_ptr->MIME_TYPE, "valid");
+    md->setData(d_ptr->MIME_TYPE,
+        QByteArray(reinterpret_cast<const char*>(&p), sizeof(ConnectionPayload))
+    );
+
+    d_ptr->m_hDragged[serial] = idx;
+
+    const auto d = d_ptr;
+
+    connect(md, &QObject::destroyed, d_ptr, [d, serial]() {
+        d->m_hDragged.remove(serial);
+    });
 
     return md;
 }
 
+static bool decodePayload(const QMimeData* data, ConnectionPayload& p)
+{
+    if (!data)
+        return false;
+
+    const QByteArray buf = data->data(QStringLiteral("qt-model/reactive-connection"));
+
+    if (buf.size() != int(sizeof(ConnectionPayload)))
+        return false;
+
+    memcpy(&p, buf.constData(), sizeof(ConnectionPayload));
+
+    return p.version == ConnectionPayload::VERSION;
+}
+
+bool QReactiveProxyModelPrivate::decode(const QMimeData* data, ConnectionPayload& p) const
+{
+    return decodePayload(data, p)
+        && p.model == quint64(reinterpret_cast<quintptr>(q_ptr));
+}
+
+QModelIndex QReactiveProxyModelPrivate::sourceIndex(const ConnectionPayload& p) const
+{
+    // Invalid if the source was removed while dragging
+    return m_hDragged.value(p.serial);
+}
+
+quint32 QReactiveProxyModel::draggedTypeId(const QMimeData* data)
+{
+    ConnectionPayload p;
+
+    return decodePayload(data, p) ? p.metaType : quint32(QMetaType::UnknownType);
+}
+
 bool QReactiveProxyModel::canDropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent) const
 {
     const auto idx = index(row, column, parent);
@@ -139,23 +231,38 @@ bool QReactiveProxyModel::canDropMimeData(const QMimeData *data, Qt::DropAction
     if ((!data) || (!idx.isValid()) || !(action & supportedDropActions()))
         return QIdentityProxyModel::canDropMimeData(data, action, row, column, parent);
 
-    if (!data->hasFormat(d_ptr->MIME_TYPE))
+    ConnectionPayload p;
+
+    if (!d_ptr->decode(data, p))
         return QIdentityProxyModel::canDropMimeData(data, action, row, column, parent);
 
-    // Try to decode `application/x-qabstractitemmodeldatalist`
-    QModelDataListDecoder decoder(data);
+    if (!(p.flags & Qt::ItemIsDragEnabled))
+        return false;
+
+    const int destType = idx.data(Qt::EditRole).userType();
 
-    return decoder.canConvert(idx.data(Qt::EditRole).userType());
+    if (p.metaType == quint32(destType))
+        return true;
+
+    // The QObject conversions depend on the object, not only its type
+    if (QMetaType::typeFlags(p.metaType) & QMetaType::PointerToQObject) {
+        const auto src = d_ptr->sourceIndex(p);
+        return src.isValid() && src.data(Qt::EditRole).canConvert(destType);
+    }
+
+    return QVariant(int(p.metaType), Q_NULLPTR).canConvert(destType);
 }
 
 bool QReactiveProxyModel::dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent)
 {
     Q_UNUSED(action)
 
-    if ((!data) || !data->hasFormat(d_ptr->MIME_TYPE))
+    ConnectionPayload p;
+
+    if (!d_ptr->decode(data, p))
         return QIdentityProxyModel::dropMimeData(data, action, row, column, parent);
 
-    const auto srcIdx  = d_ptr->m_hDraggedIndexCache[data];
+    const auto srcIdx  = d_ptr->sourceIndex(p);
     const auto destIdx = index(row, column, parent);
 
     if ((!srcIdx.isValid()) || !destIdx.isValid())
@@ -258,7 +365,7 @@ ConnectionHolder* QReactiveProxyModelPrivate::newConnection()
     if (m_lConnections.isEmpty() || m_lConnections.last()->isUsed()) {
         const int id = m_lConnections.size();
 
-        auto conn = new ConnectionHolder { id, {}, {}, {}, {}, };
+        auto conn = new ConnectionHolder { id, {}, {} };
 
         // Register the connection
         //m_pConnectionModel->beginInsertRows({}, id, id); //FIXME conflict with rowCount
@@ -269,6 +376,52 @@ ConnectionHolder* QReactiveProxyModelPrivate::newConnection()
     return m_lConnections.last();
 }
 
+void QReactiveProxyModelPrivate::link(ConnectionHolder* conn, const QModelIndex& idx)
+{
+    if (!idx.isValid())
+        return;
+
+    auto& conns = m_hDirectMapping[idx];
+
+    if (!conns.contains(conn))
+        conns << conn;
+}
+
+void QReactiveProxyModelPrivate::unlink(ConnectionHolder* conn, const QModelIndex& idx)
+{
+    const auto it = m_hDirectMapping.find(idx);
+
+    if (it == m_hDirectMapping.end())
+        return;
+
+    it->removeOne(conn);
+
+    if (it->isEmpty())
+        m_hDirectMapping.erase(it);
+}
+
+void QReactiveProxyModelPrivate::slotRebuildMapping()
+{
+    m_hDirectMapping.clear();
+
+    for (auto conn : qAsConst(m_lConnections)) {
+        link(conn, conn->source     );
+        link(conn, conn->destination);
+    }
+}
+
+/// The index in this model of an index of a proxy on top of it
+QModelIndex QReactiveProxyModelPrivate::toLocal(const QModelIndex& idx) const
+{
+    auto i = idx;
+
+    #define M qobject_cast<const QAbstractProxyModel*>(i.model())
+    while (i.model() != q_ptr && M && (i = M->mapToSource(i)).isValid());
+    #undef M
+
+    return i.model() == q_ptr ? i : QModelIndex();
+}
+
 bool QReactiveProxyModel::connectIndices(const QModelIndex& srcIdx, const QModelIndex& destIdx)
 {
     if (!(srcIdx.isValid() && destIdx.isValid()))
@@ -289,17 +442,9 @@ bool QReactiveProxyModel::connectIndices(const QModelIndex& srcIdx, const QModel
 
     conn->source        = srcIdx;
     conn->destination   = destIdx;
-    conn->sourceIP      = srcIdx.internalPointer();
-    conn->destinationIP = destIdx.internalPointer();
 
-    // Check if there is an internal pointer or UID, models can work without
-    // them, better not assume they exist. It is also not possible to assume
-    // they are valid or unique. This is checked when it is retrieved.
-    if (srcIdx.internalPointer())
-        d_ptr->m_hDirectMapping[ srcIdx.internalPointer () ] = conn; //FIXME this limits the number of connections to 1
-
-    if (destIdx.internalPointer())
-        d_ptr->m_hDirectMapping[ destIdx.internalPointer() ] = conn; //FIXME this limits the number of connections to 1
+    d_ptr->link(conn, srcIdx );
+    d_ptr->link(conn, destIdx);
 
     // Sync the current source value into the sink
     d_ptr->synchronize(srcIdx, destIdx);
@@ -359,38 +504,28 @@ bool ConnectedIndicesModel::setData(const QModelIndex &index, const QVariant &va
         case QReactiveProxyModel::ConnectionsRoles::SOURCE_INDEX: // also DEST
             Q_ASSERT(index.column() != 1);
             if (index.column() == QReactiveProxyModel::ConnectionsColumns::SOURCE && i != conn->source) {
-                d_ptr->m_hDirectMapping.remove(conn->sourceIP);
+                d_ptr->unlink(conn, conn->source);
 
                 if (wasValid)
                     Q_EMIT d_ptr->q_ptr->disconnected(conn->source, conn->destination);
 
                 conn->source = i;
+                d_ptr->link(conn, i);
 
-                if (i.isValid()) {
-                    conn->sourceIP = i.internalPointer();
-                    d_ptr->m_hDirectMapping[i.internalPointer()] = conn;
-                }
-                else
-                    conn->sourceIP = nullptr;
                 d_ptr->synchronize(conn->source, conn->destination);
 
                 if (conn->isValid())
                     d_ptr->notifyConnect(conn->source, conn->destination);
             }
             else if (index.column() == QReactiveProxyModel::ConnectionsColumns::DESTINATION && i != conn->destination) {
-                d_ptr->m_hDirectMapping.remove(conn->destinationIP);
+                d_ptr->unlink(conn, conn->destination);
 
                 if (wasValid)
                     Q_EMIT d_ptr->q_ptr->disconnected(conn->source, conn->destination);
 
                 conn->destination = i;
+                d_ptr->link(conn, i);
 
-                if (i.isValid()) {
-                    conn->destinationIP = i.internalPointer();
-                    d_ptr->m_hDirectMapping[i.internalPointer()] = conn;
-                }
-                else
-                    conn->destinationIP = nullptr;
                 d_ptr->synchronize(conn->source, conn->destination);
 
                 if (conn->isValid())
@@ -528,41 +663,53 @@ bool QReactiveProxyModelPrivate::synchronize(const QModelIndex& s, const QModelI
 
     const auto roles = m_lConnectedRoles.size() ? &m_lConnectedRoles : &(fallbackRole);
 
-    for (int role : qAsConst(*roles)) {
-        const auto md = q_ptr->mimeData({s});
-
-        q_ptr->canDropMimeData(
-            md, Qt::LinkAction, d.row(), d.column(), d.parent()
-        );
+    for (int role : qAsConst(*roles))
         q_ptr->setData(d, s.data(role) , role);
-    }
 
     return true;
 }
 
-void QReactiveProxyModelPrivate::slotMimeDestroyed()
-{
-    // collect the garbage
-    m_hDraggedIndexCache.remove(static_cast<QMimeData*>(QObject::sender()));
-}
-
-void QReactiveProxyModelPrivate::slotDataChanged(const QModelIndex& tl, const QModelIndex& br)
+void QReactiveProxyModelPrivate::slotDataChanged(const QModelIndex& tl, const QModelIndex& br, const QVector<int>& roles)
 {
     if (!tl.isValid())
         return;
 
+    // The colors, geometry and so on are never propagated
+    if (!roles.isEmpty()) {
+        const auto& connected = m_lConnectedRoles.isEmpty() ?
+            QVector<int> {Qt::DisplayRole} : m_lConnectedRoles;
+
+        if (std::none_of(roles.constBegin(), roles.constEnd(), [&connected](int r) {
+            return connected.contains(r);
+        }))
+            return;
+    }
+
     // To avoid doing a foreach of the index matrix, this model ties to implement
     // some "hacky" optimizations to keep the overhead low. There is 3 scenarios:
     //
-    //  1) There is only 1 changed item. Then use the internal pointers has hash
-    //     keys.
+    //  1) There is only 1 changed item. Then use the index as hash key.
     //  2) The top_left...bottom_right is smaller than the number of connected
     //     pairs. Then foreach the matrix
     //  3) The matrix is larger than the number of connections. Then foreach
     //     the connections. And use the `parent()` and `<=` `>=` operators.
     // Only 1 item changed
     if (tl == br) {
-        if (const auto conn = m_hDirectMapping[tl.internalPointer()]) {
+        // The current proxy has its own indices
+        const auto idx = toLocal(tl);
+        const auto it  = m_hDirectMapping.constFind(idx);
+
+        if (it == m_hDirectMapping.constEnd())
+            return;
+
+        // Copy, the propagation can change the connections
+        const auto conns = *it;
+
+        for (auto conn : conns) {
+            // The changes only flow from the source to the destination
+            if (conn->source != idx)
+                continue;
+
             if (synchronize(conn->source, conn->destination))
                 Q_EMIT m_pConnectionModel->dataChanged(
                     m_pConnectionModel->index(conn->index, 0),
@@ -576,7 +723,7 @@ void QReactiveProxyModelPrivate::slotDataChanged(const QModelIndex& tl, const QM
         for (int i = tl.row(); i <= br.row(); i++)
             for (int j = tl.column(); j <= br.column(); j++) {
                 const auto idx = tl.model()->index(i, j, tl.parent());
-                slotDataChanged(idx, idx);
+                slotDataChanged(idx, idx, roles);
             }
     }
 
@@ -591,11 +738,11 @@ void QReactiveProxyModelPrivate::slotRemoveItem(const QModelIndex &parent, int f
         const int cc = q_ptr->columnCount(parent);
         for (int j=0 ; j < cc; j++) {
             const auto idx = q_ptr->index(i, j, parent);
-            if (auto conn = m_hDirectMapping[idx.internalPointer()]) {
+
+            // The mapping is rebuilt once the rows are removed
+            for (auto conn : m_hDirectMapping.value(idx)) {
                 conn->source        = QModelIndex();
                 conn->destination   = QModelIndex();
-                conn->sourceIP      = Q_NULLPTR;
-                conn->destinationIP = Q_NULLPTR;
 
                 Q_EMIT m_pConnectionModel->dataChanged(
                     m_pConnectionModel->index(conn->index, 0),
@@ -67,6 +67,12 @@ public:
     virtual QStringList mimeTypes() const override;
     virtual Qt::ItemFlags flags(const QModelIndex &idx) const override;
 
+    /**
+     * The QMetaType of the connection source being dragged. It is read from
+     * the MIME payload, so the value itself is never decoded.
+     */
+    static quint32 draggedTypeId(const QMimeData* data);
+
     void addConnectedRole(int role);
     QVector<int> connectedRoles() const;
 
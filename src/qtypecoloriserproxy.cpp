@@ -1,19 +1,98 @@
 #include "qtypecoloriserproxy.h"
 
 #include <QtCore/QDebug>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
 
 class QTypeColoriserProxyPrivate
 {
 public:
     int m_Role {Qt::EditRole};
 
-    QHash<quint32, QVariant> m_lBg;
-    QHash<quint32, QVariant> m_lFg;
+    // Indexed by type id, invalid when not set
+    QVector<QVariant> m_lBg;
+    QVector<QVariant> m_lFg;
+
+    // Reading the base role can go through the whole model chain just to
+    // get the type, so it is remembered until the value changes
+    mutable QHash<QModelIndex, int> m_hTypes;
+
+    // Helpers
+    int typeForIndex(const QModelIndex& idx) const;
+    static void setColor(QVector<QVariant>& table, quint32 typeId, const QVariant& value);
+    void invalidate(const QModelIndex& tl, const QModelIndex& br, const QVector<int>& roles);
 };
 
 QTypeColoriserProxy::QTypeColoriserProxy(QObject* parent) : QIdentityProxyModel(parent),
     d_ptr(new QTypeColoriserProxyPrivate)
 {
+    // The identity proxy forwards the source signals, the indices are
+    // dropped before anything moves. The slots running in between can read
+    // the types of the old rows again, so they are dropped once it is done
+    // too. These connections come first, before the ones of the subclasses.
+    const auto clear = [this]() { d_ptr->m_hTypes.clear(); };
+
+    connect(this, &QAbstractItemModel::rowsAboutToBeInserted , this, clear);
+    connect(this, &QAbstractItemModel::rowsAboutToBeRemoved  , this, clear);
+    connect(this, &QAbstractItemModel::rowsAboutToBeMoved    , this, clear);
+    connect(this, &QAbstractItemModel::layoutAboutToBeChanged, this, clear);
+    connect(this, &QAbstractItemModel::modelAboutToBeReset   , this, clear);
+
+    connect(this, &QAbstractItemModel::rowsInserted , this, clear);
+    connect(this, &QAbstractItemModel::rowsRemoved  , this, clear);
+    connect(this, &QAbstractItemModel::rowsMoved    , this, clear);
+    connect(this, &QAbstractItemModel::layoutChanged, this, clear);
+    connect(this, &QAbstractItemModel::modelReset   , this, clear);
+
+    connect(this, &QAbstractItemModel::dataChanged, this,
+        [this](const QModelIndex& tl, const QModelIndex& br, const QVector<int>& roles) {
+            d_ptr->invalidate(tl, br, roles);
+    });
+}
+
+int QTypeColoriserProxyPrivate::typeForIndex(const QModelIndex& idx) const
+{
+    const auto it = m_hTypes.constFind(idx);
+
+    if (it != m_hTypes.constEnd())
+        return *it;
+
+    const int t = idx.data(m_Role).userType();
+
+    m_hTypes[idx] = t;
+
+    return t;
+}
+
+void QTypeColoriserProxyPrivate::setColor(QVector<QVariant>& table, quint32 typeId, const QVariant& value)
+{
+    if (typeId >= quint32(table.size()))
+        table.resize(typeId + 1);
+
+    table[typeId] = value;
+}
+
+void QTypeColoriserProxyPrivate::invalidate(const QModelIndex& tl, const QModelIndex& br, const QVector<int>& roles)
+{
+    if (m_hTypes.isEmpty())
+        return;
+
+    if ((!roles.isEmpty()) && !roles.contains(m_Role))
+        return;
+
+    const int rows = br.row() - tl.row() + 1;
+    const int cols = br.column() - tl.column() + 1;
+
+    // Removing one by one is only worth it for small ranges
+    if ((!tl.isValid()) || rows * cols > m_hTypes.size()) {
+        m_hTypes.clear();
+        return;
+    }
+
+    for (int r = tl.row(); r <= br.row(); r++) {
+        for (int c = tl.column(); c <= br.column(); c++)
+            m_hTypes.remove(tl.sibling(r, c));
+    }
 }
 
 QVariant QTypeColoriserProxy::data(const QModelIndex& idx, int role) const
@@ -22,16 +101,18 @@ QVariant QTypeColoriserProxy::data(const QModelIndex& idx, int role) const
         return {};
 
     switch(role) {
-        case Qt::BackgroundRole: {
-            const auto t = idx.data(d_ptr->m_Role).userType();
-            if (d_ptr->m_lBg.contains(t))
-                return d_ptr->m_lBg[t];
-        }
-        break;
+        case Qt::BackgroundRole:
         case Qt::ForegroundRole: {
-            const auto t = idx.data(d_ptr->m_Role).userType();
-            if (d_ptr->m_lFg.contains(t))
-                return d_ptr->m_lFg[idx.data(d_ptr->m_Role).userType()];
+            const auto& table = role == Qt::BackgroundRole ?
+                d_ptr->m_lBg : d_ptr->m_lFg;
+
+            if (table.isEmpty())
+                break;
+
+            const int t = d_ptr->typeForIndex(idx);
+
+            if (t >= 0 && t < table.size() && table[t].isValid())
+                return table[t];
         }
         break;
     };
@@ -52,17 +133,19 @@ int QTypeColoriserProxy::baseRole() const
 void QTypeColoriserProxy::setBaseRole(int role)
 {
     d_ptr->m_Role = role;
-    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount()-1));
+    d_ptr->m_hTypes.clear();
+    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount()-1),
+        {Qt::BackgroundRole, Qt::ForegroundRole});
 }
 
 void QTypeColoriserProxy::setForegroundRole(quint32 typeId, const QVariant& value)
 {
-    d_ptr->m_lFg[typeId] = value;
-    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount()-1));
+    d_ptr->setColor(d_ptr->m_lFg, typeId, value);
+    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount()-1), {Qt::ForegroundRole});
 }
 
 void QTypeColoriserProxy::setBackgroundRole(quint32 typeId, const QVariant& value)
 {
-    d_ptr->m_lBg[typeId] = value;
-    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount()-1));
+    d_ptr->setColor(d_ptr->m_lBg, typeId, value);
+    Q_EMIT dataChanged(index(0,0), index(rowCount()-1, columnCount()-1), {Qt::BackgroundRole});
 }